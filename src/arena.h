@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+using namespace std;
+
+// Arena monotônica para o estado temporário de UMA resolução
+// (mensagens, decisões, filas de NS...). Alocar é só avançar um ponteiro;
+// liberar é reset() de uma vez quando a resolução termina.
+// O buffer inicial é reaproveitado entre resoluções, então no caso comum
+// nada chega ao alocador global.
+class ResolveArena
+{
+public:
+  explicit ResolveArena(size_t initial_bytes = 64 * 1024)
+    : buf_(new byte[initial_bytes]),
+      mr_(buf_.get(), initial_bytes, pmr::new_delete_resource()) {}
+
+  ResolveArena(const ResolveArena&) = delete;
+  ResolveArena& operator=(const ResolveArena&) = delete;
+
+  pmr::memory_resource* resource() { return &mr_; }
+
+  // Descarta tudo que foi alocado (volta ao buffer inicial)
+  void reset() { mr_.release(); }
+
+  // Escopo aninhável: resoluções internas (ex.: IP de NS sem glue) usam a
+  // mesma arena; ela só é zerada quando o escopo mais externo termina.
+  class Scope
+  {
+  public:
+    explicit Scope(ResolveArena& a) : a_(a) { ++a_.depth_; }
+    ~Scope()
+    {
+      if (--a_.depth_ == 0)
+        a_.reset();
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    ResolveArena& a_;
+  };
+
+private:
+  unique_ptr<byte[]> buf_;
+  pmr::monotonic_buffer_resource mr_;
+  int depth_ = 0;
+};
@@ -1,227 +1,480 @@
-#include "cache.h"
-
-bool
-DnsCache::isExpired_(uint64_t now_ms, const Node& n) const
-{
-  return now_ms >= n.expires_at_ms;
-}
-
-// Construtor salva a capacidade max de positivos e negativos
-DnsCache::DnsCache(size_t cap_pos, size_t cap_neg)
-  : cap_pos_(cap_pos), cap_neg_(cap_neg) {}
-
-// Reordena o item acessado para o início da fina
-void
-DnsCache::touch_(list<CacheKey>::iterator it)
-{
-  // move para frente (mais recente)
-  lru_.splice(lru_.begin(), lru_, it);
-}
-
-void
-DnsCache::eraseNode_(const CacheKey& key, const Node& n)
-{
-  // Ajusta contadores conforme o tipo
-  if (holds_alternative<PositiveEntry>(n.val))
-  {
-    if (pos_count_ > 0)
-        --pos_count_;
-  }
-  else
-  {
-    if (neg_count_ > 0)
-        --neg_count_;
-  }
-  lru_.erase(n.it_lru);
-  map_.erase(key);
-}
-
-// Se o map exceder a capacidade, remove os menos recentes
-void
-DnsCache::evictIfNeeded_()
-{
-  // Enquanto uma das cotas estiver estourada, remove do fundo
-  while ((pos_count_ > cap_pos_) || (neg_count_ > cap_neg_))
-  {
-    if (lru_.empty())
-      break;
-
-    // Procura do fundo (menos recente) o 1º do tipo que está acima da cota
-    auto it_tail = lru_.end();
-
-    --it_tail;
-
-    // Em alguns casos, o item do fundo pode ser do "tipo certo",
-    // senão caminhamos para trás até encontrar um do tipo que precisa ser evicto.
-    bool removed = false;
-
-    for (auto it = it_tail; ; )
-    {
-      const CacheKey& key = *it;
-      auto m = map_.find(key);
-
-      if (m != map_.end())
-      {
-        bool isPos = holds_alternative<PositiveEntry>(m->second.val);
-
-        if ((isPos && pos_count_ > cap_pos_) || (!isPos && neg_count_ > cap_neg_))
-        {
-          eraseNode_(key, m->second);
-          removed = true;
-          break;
-        }
-      }
-      if (it == lru_.begin())
-        break;
-      --it;
-    }
-
-    // Se não achou nada para remover (pouco provável), quebra pra evitar loop
-    if (!removed) break;
-  }
-}
-
-// Busca positiva
-optional<PositiveEntry>
-DnsCache::getPositive(const CacheKey& key, uint64_t now_ms)
-{
-  auto it = map_.find(key);
-
-  if (it == map_.end())
-    return nullopt;
-
-  Node& n = it->second;
-
-  if (isExpired_(now_ms, n))
-  {
-    eraseNode_(key, n);
-    return nullopt;
-  }
-  if (!holds_alternative<PositiveEntry>(n.val))
-  {
-    // Existe entrada, mas é negativa → não é um "hit" positivo
-    return nullopt;
-  }
-  touch_(n.it_lru);
-  return get<PositiveEntry>(n.val);
-}
-
-// Busca negativa
-optional<NegativeEntry>
-DnsCache::getNegative(const CacheKey& key, uint64_t now_ms)
-{
-  auto it = map_.find(key);
-
-  if (it == map_.end())
-    return nullopt;
-
-  Node& n = it->second;
-
-  if (isExpired_(now_ms, n))
-  {
-    eraseNode_(key, n);
-    return nullopt;
-  }
-
-  if (!holds_alternative<NegativeEntry>(n.val))
-  {
-    return nullopt;
-  }
-
-  touch_(n.it_lru);
-  return get<NegativeEntry>(n.val);
-}
-
-void
-DnsCache::putPositive(const CacheKey& key, PositiveEntry entry, uint64_t /*now_ms*/)
-{
-  auto it = map_.find(key);
-
-  if (it != map_.end())
-  {
-    // Atualiza, mantendo a posição na LRU
-    Node& n = it->second;
-
-    // Se era negativa, ajusta contadores
-    if (holds_alternative<NegativeEntry>(n.val))
-    {
-      if (neg_count_ > 0)
-        --neg_count_;
-      ++pos_count_;
-    }
-    n.expires_at_ms = entry.expires_at_ms;
-    n.val = move(entry);
-    touch_(n.it_lru);
-  }
-  else
-  {
-    // Novo
-    lru_.push_front(key);
-
-    Node n;
-
-    n.it_lru = lru_.begin();
-    n.expires_at_ms = entry.expires_at_ms;
-    n.val = move(entry);
-    map_.insert({key, move(n)});
-    ++pos_count_;
-  }
-
-  evictIfNeeded_();
-}
-
-void
-DnsCache::putNegative(const CacheKey& key, NegativeEntry entry, uint64_t /*now_ms*/)
-{
-  auto it = map_.find(key);
-
-  if (it != map_.end())
-  {
-    Node& n = it->second;
-    
-    if (holds_alternative<PositiveEntry>(n.val))
-    {
-      if (pos_count_ > 0)
-        --pos_count_;
-      ++neg_count_;
-    }
-    n.expires_at_ms = entry.expires_at_ms;
-    n.val = move(entry);
-    touch_(n.it_lru);
-  }
-  else
-  {
-    lru_.push_front(key);
-
-    Node n;
-
-    n.it_lru = lru_.begin();
-    n.expires_at_ms = entry.expires_at_ms;
-    n.val = move(entry);
-    map_.insert({key, move(n)});
-    ++neg_count_;
-  }
-
-  evictIfNeeded_();
-}
-
-void
-DnsCache::purgeExpired(uint64_t now_ms)
-{
-  for (auto it = map_.begin(); it != map_.end(); )
-  {
-    Node& n = it->second;
-
-    if (isExpired_(now_ms, n))
-    {
-      // Apaga com ajuste de contadores
-      auto to_erase = it++;
-
-      eraseNode_(to_erase->first, to_erase->second);
-    }
-    else
-    {
-      ++it;
-    }
-  }
-}
\ No newline at end of file
+#include "cache.h"
+
+// ---- Roda de expiração ----
+
+void
+ExpiryWheel::unlink_(ExpiryHook* h)
+{
+  if (h->prev)
+    h->prev->next = h->next;
+  else
+    slots_[h->level][h->slot] = h->next;
+  if (h->next)
+    h->next->prev = h->prev;
+  h->prev = h->next = nullptr;
+  h->level = -1;
+}
+
+// Retira a lista inteira de uma posição (os ganchos ficam "soltos")
+ExpiryHook*
+ExpiryWheel::takeSlot_(int level, uint64_t slot)
+{
+  ExpiryHook* head = slots_[level][slot];
+
+  slots_[level][slot] = nullptr;
+  for (ExpiryHook* h = head; h; h = h->next)
+  {
+    h->level = -1;
+    --count_;
+  }
+  // prev/next continuam encadeando a lista retirada até o chamador reposicionar
+  return head;
+}
+
+// Escolhe nível/posição pela distância até o prazo.
+// min_tick: primeiro tick que ainda será processado.
+void
+ExpiryWheel::place_(ExpiryHook* h, uint64_t min_tick)
+{
+  uint64_t t = (h->expires_at_ms + tick_ms_ - 1) / tick_ms_; // arredonda p/ cima
+
+  if (t < min_tick)
+    t = min_tick;
+
+  uint64_t delta = t - cur_tick_;
+  int level = 0;
+
+  while (level < kLevels - 1 && delta >= (uint64_t(1) << (kBits * (level + 1))))
+    ++level;
+  if (delta >= (uint64_t(1) << (kBits * kLevels)))
+    t = cur_tick_ + (uint64_t(1) << (kBits * kLevels)) - 1; // trunca no último nível
+
+  uint64_t slot = (t >> (kBits * level)) & (kSlots - 1);
+
+  h->level = static_cast<int8_t>(level);
+  h->slot = static_cast<uint8_t>(slot);
+  h->prev = nullptr;
+  h->next = slots_[level][slot];
+  if (h->next)
+    h->next->prev = h;
+  slots_[level][slot] = h;
+  ++count_;
+}
+
+void
+ExpiryWheel::schedule(ExpiryHook* h, uint64_t now_ms)
+{
+  if (!started_)
+  {
+    cur_tick_ = now_ms / tick_ms_;
+    started_ = true;
+  }
+  cancel(h);
+  place_(h, cur_tick_ + 1);
+}
+
+void
+ExpiryWheel::cancel(ExpiryHook* h)
+{
+  if (h->level < 0)
+    return;
+  unlink_(h);
+  --count_;
+}
+
+// ---- DnsCache ----
+
+bool
+DnsCache::isExpired_(uint64_t now_ms, const Node& n) const
+{
+  return now_ms >= n.expires_at_ms;
+}
+
+// Construtor salva a capacidade max de positivos e negativos
+DnsCache::DnsCache(size_t cap_pos, size_t cap_neg)
+  : cap_pos_(cap_pos), cap_neg_(cap_neg) {}
+
+// Reordena o item acessado para o início da fina
+void
+DnsCache::touch_(list<CacheKey>::iterator it)
+{
+  // move para frente (mais recente)
+  lru_.splice(lru_.begin(), lru_, it);
+}
+
+void
+DnsCache::scheduleExpiry_(Map::iterator it, uint64_t now_ms)
+{
+  Node& n = it->second;
+
+  n.exp.key = &it->first;
+  n.exp.expires_at_ms = n.expires_at_ms;
+  wheel_.schedule(&n.exp, now_ms);
+}
+
+void
+DnsCache::eraseNode_(Map::iterator it)
+{
+  Node& n = it->second;
+
+  // Ajusta contadores conforme o tipo
+  if (holds_alternative<PositiveEntry>(n.val))
+  {
+    if (pos_count_ > 0)
+        --pos_count_;
+  }
+  else
+  {
+    if (neg_count_ > 0)
+        --neg_count_;
+  }
+  wheel_.cancel(&n.exp);
+  lru_.erase(n.it_lru);
+  map_.erase(it);
+}
+
+// Se o map exceder a capacidade, remove os menos recentes
+void
+DnsCache::evictIfNeeded_()
+{
+  // Enquanto uma das cotas estiver estourada, remove do fundo
+  while ((pos_count_ > cap_pos_) || (neg_count_ > cap_neg_))
+  {
+    if (lru_.empty())
+      break;
+
+    // Procura do fundo (menos recente) o 1º do tipo que está acima da cota
+    auto it_tail = lru_.end();
+
+    --it_tail;
+
+    // Em alguns casos, o item do fundo pode ser do "tipo certo",
+    // senão caminhamos para trás até encontrar um do tipo que precisa ser evicto.
+    bool removed = false;
+
+    for (auto it = it_tail; ; )
+    {
+      const CacheKey& key = *it;
+      auto m = map_.find(key);
+
+      if (m != map_.end())
+      {
+        bool isPos = holds_alternative<PositiveEntry>(m->second.val);
+
+        if ((isPos && pos_count_ > cap_pos_) || (!isPos && neg_count_ > cap_neg_))
+        {
+          eraseNode_(m);
+          removed = true;
+          break;
+        }
+      }
+      if (it == lru_.begin())
+        break;
+      --it;
+    }
+
+    // Se não achou nada para remover (pouco provável), quebra pra evitar loop
+    if (!removed) break;
+  }
+}
+
+// Busca positiva
+optional<PositiveEntry>
+DnsCache::getPositive(const CacheKey& key, uint64_t now_ms)
+{
+  auto it = map_.find(key);
+
+  if (it == map_.end())
+    return nullopt;
+
+  Node& n = it->second;
+
+  if (isExpired_(now_ms, n))
+  {
+    eraseNode_(it);
+    return nullopt;
+  }
+  if (!holds_alternative<PositiveEntry>(n.val))
+  {
+    // Existe entrada, mas é negativa → não é um "hit" positivo
+    return nullopt;
+  }
+  touch_(n.it_lru);
+  return get<PositiveEntry>(n.val);
+}
+
+// Busca negativa
+optional<NegativeEntry>
+DnsCache::getNegative(const CacheKey& key, uint64_t now_ms)
+{
+  auto it = map_.find(key);
+
+  if (it == map_.end())
+    return nullopt;
+
+  Node& n = it->second;
+
+  if (isExpired_(now_ms, n))
+  {
+    eraseNode_(it);
+    return nullopt;
+  }
+
+  if (!holds_alternative<NegativeEntry>(n.val))
+  {
+    return nullopt;
+  }
+
+  touch_(n.it_lru);
+  return get<NegativeEntry>(n.val);
+}
+
+optional<PositiveEntry>
+DnsCache::peekPositive(const CacheKey& key, uint64_t now_ms) const
+{
+  auto it = map_.find(key);
+
+  if (it == map_.end() || isExpired_(now_ms, it->second))
+    return nullopt;
+  if (!holds_alternative<PositiveEntry>(it->second.val))
+    return nullopt;
+  return get<PositiveEntry>(it->second.val);
+}
+
+optional<NegativeEntry>
+DnsCache::peekNegative(const CacheKey& key, uint64_t now_ms) const
+{
+  auto it = map_.find(key);
+
+  if (it == map_.end() || isExpired_(now_ms, it->second))
+    return nullopt;
+  if (!holds_alternative<NegativeEntry>(it->second.val))
+    return nullopt;
+  return get<NegativeEntry>(it->second.val);
+}
+
+void
+DnsCache::touch(const CacheKey& key)
+{
+  auto it = map_.find(key);
+
+  if (it != map_.end())
+    touch_(it->second.it_lru);
+}
+
+void
+DnsCache::putPositive(const CacheKey& key, PositiveEntry entry, uint64_t now_ms)
+{
+  auto it = map_.find(key);
+
+  if (it != map_.end())
+  {
+    // Atualiza, mantendo a posição na LRU
+    Node& n = it->second;
+
+    // Se era negativa, ajusta contadores
+    if (holds_alternative<NegativeEntry>(n.val))
+    {
+      if (neg_count_ > 0)
+        --neg_count_;
+      ++pos_count_;
+    }
+    n.expires_at_ms = entry.expires_at_ms;
+    n.val = move(entry);
+    touch_(n.it_lru);
+    scheduleExpiry_(it, now_ms);
+  }
+  else
+  {
+    // Novo
+    lru_.push_front(key);
+
+    Node n;
+
+    n.it_lru = lru_.begin();
+    n.expires_at_ms = entry.expires_at_ms;
+    n.val = move(entry);
+    scheduleExpiry_(map_.emplace(key, move(n)).first, now_ms);
+    ++pos_count_;
+  }
+
+  evictIfNeeded_();
+}
+
+void
+DnsCache::putNegative(const CacheKey& key, NegativeEntry entry, uint64_t now_ms)
+{
+  auto it = map_.find(key);
+
+  if (it != map_.end())
+  {
+    Node& n = it->second;
+    
+    if (holds_alternative<PositiveEntry>(n.val))
+    {
+      if (pos_count_ > 0)
+        --pos_count_;
+      ++neg_count_;
+    }
+    n.expires_at_ms = entry.expires_at_ms;
+    n.val = move(entry);
+    touch_(n.it_lru);
+    scheduleExpiry_(it, now_ms);
+  }
+  else
+  {
+    lru_.push_front(key);
+
+    Node n;
+
+    n.it_lru = lru_.begin();
+    n.expires_at_ms = entry.expires_at_ms;
+    n.val = move(entry);
+    scheduleExpiry_(map_.emplace(key, move(n)).first, now_ms);
+    ++neg_count_;
+  }
+
+  evictIfNeeded_();
+}
+
+void
+DnsCache::purgeExpired(uint64_t now_ms)
+{
+  // Só visita o que venceu desde a última chamada
+  wheel_.advance(now_ms, [this](ExpiryHook* h)
+  {
+    auto it = map_.find(*h->key);
+
+    if (it != map_.end())
+      eraseNode_(it);
+  });
+}
+
+// ---- ShardedDnsCache ----
+
+ShardedDnsCache::ShardedDnsCache(size_t shards, size_t cap_pos, size_t cap_neg)
+{
+  if (shards == 0)
+    shards = 1;
+
+  // Cota por shard = teto(cap / N)
+  size_t cp = (cap_pos + shards - 1) / shards;
+  size_t cn = (cap_neg + shards - 1) / shards;
+
+  shards_.reserve(shards);
+  for (size_t i = 0; i < shards; ++i)
+    shards_.push_back(make_unique<Shard>(cp, cn));
+}
+
+ShardedDnsCache::Shard&
+ShardedDnsCache::shardFor_(const CacheKey& key)
+{
+  // Usa os bits altos (misturados) para não correlacionar com os buckets do shard
+  uint64_t h = CacheKeyHash{}(key);
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return *shards_[h % shards_.size()];
+}
+
+optional<PositiveEntry>
+ShardedDnsCache::getPositive(const CacheKey& key, uint64_t now_ms)
+{
+  Shard& sh = shardFor_(key);
+  optional<PositiveEntry> out;
+
+  {
+    shared_lock<shared_mutex> lock(sh.mtx);
+
+    out = sh.cache.peekPositive(key, now_ms);
+  }
+  if (out)
+  {
+    unique_lock<shared_mutex> lock(sh.mtx, try_to_lock);
+
+    if (lock.owns_lock())
+      sh.cache.touch(key);
+  }
+  return out;
+}
+
+optional<NegativeEntry>
+ShardedDnsCache::getNegative(const CacheKey& key, uint64_t now_ms)
+{
+  Shard& sh = shardFor_(key);
+  optional<NegativeEntry> out;
+
+  {
+    shared_lock<shared_mutex> lock(sh.mtx);
+
+    out = sh.cache.peekNegative(key, now_ms);
+  }
+  if (out)
+  {
+    unique_lock<shared_mutex> lock(sh.mtx, try_to_lock);
+
+    if (lock.owns_lock())
+      sh.cache.touch(key);
+  }
+  return out;
+}
+
+void
+ShardedDnsCache::putPositive(const CacheKey& key, PositiveEntry entry, uint64_t now_ms)
+{
+  Shard& sh = shardFor_(key);
+  unique_lock<shared_mutex> lock(sh.mtx);
+
+  sh.cache.purgeExpired(now_ms);
+  sh.cache.putPositive(key, move(entry), now_ms);
+}
+
+void
+ShardedDnsCache::putNegative(const CacheKey& key, NegativeEntry entry, uint64_t now_ms)
+{
+  Shard& sh = shardFor_(key);
+  unique_lock<shared_mutex> lock(sh.mtx);
+
+  sh.cache.purgeExpired(now_ms);
+  sh.cache.putNegative(key, move(entry), now_ms);
+}
+
+void
+ShardedDnsCache::purgeExpired(uint64_t now_ms)
+{
+  for (auto& sh : shards_)
+  {
+    unique_lock<shared_mutex> lock(sh->mtx);
+
+    sh->cache.purgeExpired(now_ms);
+  }
+}
+
+size_t
+ShardedDnsCache::positiveCount() const
+{
+  size_t n = 0;
+
+  for (const auto& sh : shards_)
+  {
+    shared_lock<shared_mutex> lock(sh->mtx);
+
+    n += sh->cache.positiveCount();
+  }
+  return n;
+}
+
+size_t
+ShardedDnsCache::negativeCount() const
+{
+  size_t n = 0;
+
+  for (const auto& sh : shards_)
+  {
+    shared_lock<shared_mutex> lock(sh->mtx);
+
+    n += sh->cache.negativeCount();
+  }
+  return n;
+}
@@ -1,120 +1,280 @@
-#pragma once
-#include <string>
-#include <vector>
-#include <unordered_map>
-#include <list>
-#include <optional>
-#include <cstdint>
-#include <algorithm>
-#include <variant>
-
-using namespace std;
-
-// Resource Record
-struct RR
-{
-  string name; 
-  uint16_t type = 1;    // A
-  uint16_t rrclass = 1; // IN
-  uint32_t ttl = 0;
-  vector<uint8_t> rdata; // em bytes
-};
-
-struct SOAMeta
-{
-  uint32_t minimum = 0; // para TTL negativo (RFC 2308)
-};
-
-struct CacheKey
-{
-  string qname; // normalizado (lowercase, sem trailing dot)
-  uint16_t qtype = 1;
-  uint16_t qclass = 1; // IN
-
-  inline bool operator == (const CacheKey& o) const
-  {
-    return qtype == o.qtype && qclass == o.qclass && qname == o.qname;
-  }
-};
-
-// Combina hash do nome com qtype num inteiro
-struct CacheKeyHash
-{
-  size_t operator()(const CacheKey& k) const
-  {
-    hash<string> h1;
-    hash<uint64_t> h2;
-
-    return h1(k.qname) ^ (h2((uint64_t)k.qtype << 32 | k.qclass));
-  }
-};
-
-// Entrada positiva da cache
-struct PositiveEntry
-{
-  vector<RR> rrset;
-  uint64_t expires_at_ms = 0; // Horário de expiração
-  uint8_t rcode = 0; // NOERROR
-};
-
-// NXDOMAIN (dado não existe) NODATA(nome existe, mas não esse tipo)
-enum class NegKind { NXDOMAIN, NODATA };
-
-struct NegativeEntry
-{
-  NegKind kind = NegKind::NODATA;
-  uint64_t expires_at_ms = 0;
-  uint8_t rcode = 0; // 3 para NXDOMAIN; 0 para NODATA
-  optional<SOAMeta> soa;
-};
-
-// Estrutura principal da cache
-class DnsCache
-{
-public:
-  // Construtor define a capacidade, escolhi 50/50 (pos/neg)
-  explicit DnsCache(size_t cap_pos = 50, size_t cap_neg = 50);
-
-  // Leitura da cache
-  optional<PositiveEntry> getPositive(const CacheKey& key, uint64_t now_ms);
-  optional<NegativeEntry> getNegative(const CacheKey& key, uint64_t now_ms);
-
-  // Escrita na cache
-  void putPositive(const CacheKey& key, PositiveEntry entry, uint64_t now_ms);
-  void putNegative(const CacheKey& key, NegativeEntry entry, uint64_t now_ms);
-
-  // Remoção de entradas expiradas
-  void purgeExpired(uint64_t now_ms);
-
-private:
-  // LRU: lista de chaves; frente = mais recente
-  using EntryVariant = variant<PositiveEntry, NegativeEntry>;
-
-  struct Node
-  {
-      EntryVariant val;
-      uint64_t expires_at_ms = 0;
-      list<CacheKey>::iterator it_lru; // posição na LRU
-  };
-
-  // Estrutura única:
-  unordered_map<CacheKey, Node, CacheKeyHash> map_;
-  list<CacheKey> lru_; // frente = mais recente
-
-  // Cotas
-  size_t cap_pos_;
-  size_t cap_neg_;
-  size_t pos_count_ = 0;
-  size_t neg_count_ = 0;
-
-  // Helpers internos
-  void touch_(list<CacheKey>::iterator it);
-  bool isExpired_(uint64_t now_ms, const Node& n) const;
-
-  // Remoção (ajusta contadores)
-  void eraseNode_(const CacheKey& key, const Node& n);
-
-  // Evicção por cotas: remove do fim da LRU,
-  // mas apenas o tipo que estiver acima da sua cota.
-  void evictIfNeeded_();
-};
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <list>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+#include <variant>
+#include <memory>
+#include <shared_mutex>
+#include <mutex>
+
+using namespace std;
+
+// Resource Record
+struct RR
+{
+  string name; 
+  uint16_t type = 1;    // A
+  uint16_t rrclass = 1; // IN
+  uint32_t ttl = 0;
+  vector<uint8_t> rdata; // em bytes
+};
+
+struct SOAMeta
+{
+  uint32_t minimum = 0; // para TTL negativo (RFC 2308)
+};
+
+struct CacheKey
+{
+  string qname; // normalizado (lowercase, sem trailing dot)
+  uint16_t qtype = 1;
+  uint16_t qclass = 1; // IN
+
+  inline bool operator == (const CacheKey& o) const
+  {
+    return qtype == o.qtype && qclass == o.qclass && qname == o.qname;
+  }
+};
+
+// Combina hash do nome com qtype num inteiro
+struct CacheKeyHash
+{
+  size_t operator()(const CacheKey& k) const
+  {
+    hash<string> h1;
+    hash<uint64_t> h2;
+
+    return h1(k.qname) ^ (h2((uint64_t)k.qtype << 32 | k.qclass));
+  }
+};
+
+// Entrada positiva da cache
+struct PositiveEntry
+{
+  vector<RR> rrset;
+  uint64_t expires_at_ms = 0; // Horário de expiração
+  uint8_t rcode = 0; // NOERROR
+};
+
+// NXDOMAIN (dado não existe) NODATA(nome existe, mas não esse tipo)
+enum class NegKind { NXDOMAIN, NODATA };
+
+struct NegativeEntry
+{
+  NegKind kind = NegKind::NODATA;
+  uint64_t expires_at_ms = 0;
+  uint8_t rcode = 0; // 3 para NXDOMAIN; 0 para NODATA
+  optional<SOAMeta> soa;
+};
+
+// Gancho intrusivo da roda de expiração (mora dentro do nó da cache)
+struct ExpiryHook
+{
+  ExpiryHook* prev = nullptr;
+  ExpiryHook* next = nullptr;
+  uint64_t expires_at_ms = 0;
+  const CacheKey* key = nullptr; // chave do nó dono (estável dentro do unordered_map)
+  int8_t level = -1;             // -1 = não agendado
+  uint8_t slot = 0;
+};
+
+// Roda de tempo hierárquica (estilo timers do kernel): 4 níveis x 64 posições.
+// Agendar/cancelar é O(1); avançar custa O(1) amortizado por entrada
+// (cada uma desce no máximo 3 níveis antes de vencer).
+// Com tick de 1 s os níveis cobrem ~194 dias; prazos maiores ficam no último
+// nível e são reagendados quando ele gira.
+class ExpiryWheel
+{
+public:
+  explicit ExpiryWheel(uint64_t tick_ms = 1000) : tick_ms_(tick_ms) {}
+
+  // Insere h (h->expires_at_ms já preenchido); now_ms inicializa a roda
+  void schedule(ExpiryHook* h, uint64_t now_ms);
+
+  // Remove h se estiver agendado
+  void cancel(ExpiryHook* h);
+
+  // Avança até now_ms, chamando on_expire(h) para cada gancho vencido.
+  // O gancho já sai da roda antes do callback (que pode apagar o dono).
+  template <class F>
+  void advance(uint64_t now_ms, F on_expire);
+
+  size_t size() const { return count_; }
+
+private:
+  static constexpr int kLevels = 4;
+  static constexpr int kBits = 6;
+  static constexpr uint64_t kSlots = 1u << kBits;
+
+  ExpiryHook* slots_[kLevels][kSlots] = {};
+  uint64_t tick_ms_;
+  uint64_t cur_tick_ = 0;  // último tick processado
+  bool started_ = false;
+  size_t count_ = 0;
+
+  void place_(ExpiryHook* h, uint64_t min_tick);
+  void unlink_(ExpiryHook* h);
+  ExpiryHook* takeSlot_(int level, uint64_t slot);
+};
+
+template <class F>
+void
+ExpiryWheel::advance(uint64_t now_ms, F on_expire)
+{
+  const uint64_t target = now_ms / tick_ms_;
+
+  if (!started_ || count_ == 0)
+  {
+    // Nada agendado: só acompanha o relógio
+    if (target > cur_tick_ || !started_)
+      cur_tick_ = target;
+    started_ = true;
+    return;
+  }
+
+  while (cur_tick_ < target && count_ > 0)
+  {
+    ++cur_tick_;
+
+    // Ao virar uma posição do nível 0, desce o conteúdo do nível de cima
+    for (int lvl = 1; lvl < kLevels; ++lvl)
+    {
+      if ((cur_tick_ & ((uint64_t(1) << (kBits * lvl)) - 1)) != 0)
+        break;
+
+      ExpiryHook* h = takeSlot_(lvl, (cur_tick_ >> (kBits * lvl)) & (kSlots - 1));
+
+      while (h)
+      {
+        ExpiryHook* nx = h->next;
+
+        place_(h, cur_tick_); // o tick atual ainda vai ser processado abaixo
+        h = nx;
+      }
+    }
+
+    ExpiryHook* h = takeSlot_(0, cur_tick_ & (kSlots - 1));
+
+    while (h)
+    {
+      ExpiryHook* nx = h->next;
+
+      if (now_ms >= h->expires_at_ms)
+        on_expire(h);
+      else
+        place_(h, cur_tick_ + 1); // ainda não venceu (prazo truncado no último nível)
+      h = nx;
+    }
+  }
+  if (cur_tick_ < target)
+    cur_tick_ = target;
+}
+
+// Estrutura principal da cache
+class DnsCache
+{
+public:
+  // Construtor define a capacidade, escolhi 50/50 (pos/neg)
+  explicit DnsCache(size_t cap_pos = 50, size_t cap_neg = 50);
+
+  // Leitura da cache
+  optional<PositiveEntry> getPositive(const CacheKey& key, uint64_t now_ms);
+  optional<NegativeEntry> getNegative(const CacheKey& key, uint64_t now_ms);
+
+  // Leitura sem efeitos colaterais (não mexe na LRU nem remove expirados):
+  // pode rodar em paralelo sob lock compartilhado.
+  optional<PositiveEntry> peekPositive(const CacheKey& key, uint64_t now_ms) const;
+  optional<NegativeEntry> peekNegative(const CacheKey& key, uint64_t now_ms) const;
+
+  // Promove a chave na LRU (complemento do peek)
+  void touch(const CacheKey& key);
+
+  size_t positiveCount() const { return pos_count_; }
+  size_t negativeCount() const { return neg_count_; }
+
+  // Escrita na cache
+  void putPositive(const CacheKey& key, PositiveEntry entry, uint64_t now_ms);
+  void putNegative(const CacheKey& key, NegativeEntry entry, uint64_t now_ms);
+
+  // Remoção de entradas expiradas (via roda de tempo: não varre a tabela)
+  void purgeExpired(uint64_t now_ms);
+
+private:
+  // LRU: lista de chaves; frente = mais recente
+  using EntryVariant = variant<PositiveEntry, NegativeEntry>;
+
+  struct Node
+  {
+      EntryVariant val;
+      uint64_t expires_at_ms = 0;
+      list<CacheKey>::iterator it_lru; // posição na LRU
+      ExpiryHook exp;                  // posição na roda de expiração
+  };
+
+  using Map = unordered_map<CacheKey, Node, CacheKeyHash>;
+
+  // Estrutura única:
+  Map map_;
+  list<CacheKey> lru_; // frente = mais recente
+  ExpiryWheel wheel_;
+
+  // Cotas
+  size_t cap_pos_;
+  size_t cap_neg_;
+  size_t pos_count_ = 0;
+  size_t neg_count_ = 0;
+
+  // Helpers internos
+  void touch_(list<CacheKey>::iterator it);
+  bool isExpired_(uint64_t now_ms, const Node& n) const;
+
+  // Remoção (ajusta contadores e tira da roda)
+  void eraseNode_(Map::iterator it);
+
+  // (Re)agenda a expiração do nó na roda
+  void scheduleExpiry_(Map::iterator it, uint64_t now_ms);
+
+  // Evicção por cotas: remove do fim da LRU,
+  // mas apenas o tipo que estiver acima da sua cota.
+  void evictIfNeeded_();
+};
+
+// Cache particionada por hash da chave em N shards independentes, cada um com
+// sua LRU, cotas (cap/N) e roda de expiração, protegido por um shared_mutex.
+// Leituras usam lock compartilhado (peek); a promoção na LRU é feita só se o
+// lock exclusivo estiver livre na hora (try_lock), então hits não se
+// serializam. Expirados são removidos nas escritas e em purgeExpired.
+class ShardedDnsCache
+{
+public:
+  explicit ShardedDnsCache(size_t shards = 16, size_t cap_pos = 50, size_t cap_neg = 50);
+
+  optional<PositiveEntry> getPositive(const CacheKey& key, uint64_t now_ms);
+  optional<NegativeEntry> getNegative(const CacheKey& key, uint64_t now_ms);
+
+  void putPositive(const CacheKey& key, PositiveEntry entry, uint64_t now_ms);
+  void putNegative(const CacheKey& key, NegativeEntry entry, uint64_t now_ms);
+
+  void purgeExpired(uint64_t now_ms);
+
+  size_t shardCount() const { return shards_.size(); }
+  size_t positiveCount() const;
+  size_t negativeCount() const;
+
+private:
+  struct alignas(64) Shard
+  {
+    mutable shared_mutex mtx;
+    DnsCache cache;
+
+    Shard(size_t cp, size_t cn) : cache(cp, cn) {}
+  };
+
+  vector<unique_ptr<Shard>> shards_;
+
+  Shard& shardFor_(const CacheKey& key);
+};
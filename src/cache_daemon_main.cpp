@@ -1,342 +1,595 @@
-#include "cache.h"
-#include <string>
-#include <vector>
-#include <thread>
-#include <mutex>
-#include <sstream>
-#include <cctype>
-#include <atomic>
-#include <cstdio>
-#include <chrono>
-
-#ifdef _WIN32
-  #include <winsock2.h>
-  #include <ws2tcpip.h>
-  #pragma comment(lib, "Ws2_32.lib")
-  static void closesock(int s){ closesocket(s); }
-#else
-  #include <sys/types.h>
-  #include <sys/socket.h>
-  #include <netinet/in.h>
-  #include <arpa/inet.h>
-  #include <netdb.h>
-  #include <unistd.h>
-  static void closesock(int s){ close(s); }
-#endif
-
-static atomic<bool> running{true};
-static mutex mtx;
-static DnsCache g_cache(50, 50);
-
-static uint64_t
-nowMs()
-{
-  using namespace chrono;
-  return duration_cast<milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
-}
-
-static string
-toLower(const string& s)
-{
-  string r=s;
-
-  for (auto& c: r)
-    c = static_cast<char>(std::tolower((unsigned char)c));
-  if (!r.empty() && r.back()=='.')
-    r.pop_back();
-  return r;
-}
-
-static string
-hexEncode(const vector<uint8_t>& v)
-{
-  static const char* H = "0123456789abcdef";
-  string out; out.reserve(v.size()*2);
-
-  for (auto b: v)
-  {
-    out.push_back(H[b>>4]);
-    out.push_back(H[b&0xF]);
-  }
-  return out;
-}
-
-static vector<uint8_t>
-hexDecode(const string& s)
-{
-  vector<uint8_t> out;
-  
-  if (s.size()%2)
-    return out;
-  out.reserve(s.size()/2);
-
-  auto val=[&](char c)->int
-  {
-    if (c>='0'&&c<='9') return c-'0';
-    if (c>='a'&&c<='f') return c-'a'+10;
-    if (c>='A'&&c<='F') return c-'A'+10;
-    return -1;
-  };
-
-  for (size_t i=0;i<s.size();i+=2)
-  {
-    int hi=val(s[i]), lo=val(s[i+1]);
-
-    if (hi<0||lo<0)
-    {
-      out.clear();
-      return out;
-    }
-    out.push_back(static_cast<uint8_t>((hi<<4)|lo));
-  }
-  return out;
-}
-
-static bool
-sendLine(int fd, const string& line)
-{
-  string l = line; l.push_back('\n');
-
-#ifdef _WIN32
-  int sent = ::send(fd, l.c_str(), (int)l.size(), 0);
-  return sent == (int)l.size();
-#else
-  ssize_t sent = ::send(fd, l.data(), l.size(), 0);
-  return sent == (ssize_t)l.size();
-#endif
-}
-
-static bool
-recvLine(int fd, string& out)
-{
-  out.clear();
-
-  char c;
-
-  while (true)
-  {
-#ifdef _WIN32
-    int r = ::recv(fd, &c, 1, 0);
-#else
-    ssize_t r = ::recv(fd, &c, 1, 0);
-#endif
-    if (r<=0) return false;
-    if (c=='\n') break;
-    if (c!='\r') out.push_back(c);
-    if (out.size()>8192) return false;
-  }
-  return true;
-}
-
-static void
-handle_client(int fd)
-{
-  while (running)
-  {
-    string line;
-
-    if (!recvLine(fd, line))
-      break;
-
-    istringstream iss(line);
-    string cmd; iss >> cmd;
-
-    if (cmd.empty())
-      break;
-
-    if (cmd=="STATUS")
-    {
-      lock_guard<mutex> lock(mtx);
-      uint64_t now = nowMs();
-
-      g_cache.purgeExpired(now);
-      // Não temos contadores públicos; esta é uma resposta simples.
-      sendLine(fd, "OK cache_daemon 50/50");
-    }
-
-    else if (cmd=="GET")
-    {
-      string name;
-      unsigned type;
-
-      if (!(iss>>name>>type))
-      {
-        sendLine(fd,"ERR bad GET");
-        continue;
-      }
-      name = toLower(name);
-
-      CacheKey key{name, (uint16_t)type, 1};
-      lock_guard<mutex> lock(mtx);
-      uint64_t now = nowMs();
-
-      g_cache.purgeExpired(now);
-      if (auto pos = g_cache.getPositive(key, now))
-      {
-        // POS <ttl_restante> <n>
-        uint32_t ttl = (pos->expires_at_ms>now)? (uint32_t)((pos->expires_at_ms-now)/1000):0;
-        
-        sendLine(fd, "POS "+to_string(ttl)+" "+to_string(pos->rrset.size()));
-        for (const auto& rr: pos->rrset)
-        {
-          sendLine(fd, to_string(rr.type)+" "+to_string(rr.rrclass)+" "+to_string(rr.ttl)+" "+hexEncode(rr.rdata));
-        }
-      }
-      else if (auto neg = g_cache.getNegative(key, now))
-      {
-        uint32_t ttl = (neg->expires_at_ms>now)? (uint32_t)((neg->expires_at_ms-now)/1000):0;
-
-        sendLine(fd, "NEG "+to_string(ttl)+" "+to_string(neg->rcode));
-      }
-      else
-      {
-        sendLine(fd, "NOTFOUND");
-      }
-    }
-    else if (cmd=="PUTP")
-    {
-      string name;
-      unsigned type;
-      unsigned ttl;
-      unsigned n;
-
-      if (!(iss>>name>>type>>ttl>>n))
-      {
-        sendLine(fd,"ERR bad PUTP");
-        continue;
-      }
-      name = toLower(name);
-
-      PositiveEntry pe;
-      uint64_t now = nowMs();
-
-      pe.expires_at_ms = now + (uint64_t)ttl*1000ull;
-      pe.rcode = 0;
-      pe.rrset.reserve(n);
-      for (unsigned i=0;i<n;++i)
-      {
-        string line2;
-
-        if (!recvLine(fd, line2))
-        {
-          sendLine(fd,"ERR bad PUTP lines");
-          goto done;
-        }
-
-        istringstream is2(line2);
-        unsigned t,c,rrttl;
-        string hex; 
-
-        if (!(is2>>t>>c>>rrttl>>hex))
-        {
-          sendLine(fd,"ERR bad RR line");
-          goto done;
-        }
-
-        RR r;
-
-        r.name = name;
-        r.type=(uint16_t)t;
-        r.rrclass=(uint16_t)c;
-        r.ttl=rrttl;
-        r.rdata=hexDecode(hex);
-        pe.rrset.push_back(move(r));
-      }
-      {
-        lock_guard<mutex> lock(mtx);
-
-        g_cache.putPositive(CacheKey{name,(uint16_t)type,1}, move(pe), now);
-      }
-      sendLine(fd, "OK");
-    }
-    else if (cmd=="PUTN")
-    {
-      string name;
-      unsigned type;
-      unsigned ttl;
-      unsigned rcode;
-
-      if (!(iss>>name>>type>>ttl>>rcode))
-      {
-        sendLine(fd,"ERR bad PUTN");
-        continue;
-      }
-      name = toLower(name);
-
-      NegativeEntry ne;
-      uint64_t now = nowMs();
-
-      ne.expires_at_ms = now + (uint64_t)ttl*1000ull;
-      ne.rcode = (uint16_t)rcode;
-      ne.kind = (rcode==3)? NegKind::NXDOMAIN : NegKind::NODATA;
-      {
-        lock_guard<mutex> lock(mtx);
-        g_cache.putNegative(CacheKey{name,(uint16_t)type,1}, move(ne), now);
-      }
-      sendLine(fd, "OK");
-    }
-    else if (cmd=="QUIT" || cmd=="EXIT")
-    {
-      sendLine(fd, "BYE");
-      break;
-    }
-    else
-    {
-      sendLine(fd, "ERR unknown");
-    }
-  }
-done:
-  closesock(fd);
-}
-
-int
-main(int argc, char**)
-{
-#ifdef _WIN32
-  WSADATA wsa; WSAStartup(MAKEWORD(2,2), &wsa);
-#endif
-
-  int srv = ::socket(AF_INET, SOCK_STREAM, 0);
-
-  if (srv<0)
-  {
-    perror("socket");
-    return 1;
-  }
-
-  sockaddr_in addr{};
-  addr.sin_family=AF_INET;
-  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-  addr.sin_port = htons(5353);
-
-  int yes=1;
-
-  setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, (char*)&yes, sizeof(yes));
-  if (bind(srv, (sockaddr*)&addr, sizeof(addr))!=0)
-  {
-    perror("bind 127.0.0.1:5353");
-    return 2;
-  }
-  if (listen(srv, 16)!=0)
-  {
-    perror("listen");
-    return 3;
-  }
-
-  fprintf(stderr, "[cache_daemon] listening on 127.0.0.1:5353\n");
-
-  while (running)
-  {
-    sockaddr_in cli{};
-    socklen_t slen = sizeof(cli);
-    int fd = ::accept(srv, (sockaddr*)&cli, &slen);
-    if (fd<0)
-      continue;
-    thread(handle_client, fd).detach();
-  }
-  closesock(srv);
-#ifdef _WIN32
-  WSACleanup();
-#endif
-  return 0;
-}
+#include "cache.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <sstream>
+#include <cctype>
+#include <atomic>
+#include <cstdio>
+#include <cerrno>
+#include <chrono>
+#include <unordered_map>
+
+#ifdef _WIN32
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #pragma comment(lib, "Ws2_32.lib")
+  static void closesock(int s){ closesocket(s); }
+#else
+  #include <sys/types.h>
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+  #include <arpa/inet.h>
+  #include <netdb.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  static void closesock(int s){ close(s); }
+#endif
+#ifdef __linux__
+  #include <sys/epoll.h>
+#endif
+
+static atomic<bool> running{true};
+// Cache particionada: cada shard tem seu próprio lock (leituras compartilhadas)
+static ShardedDnsCache g_cache(16, 50, 50);
+
+static uint64_t
+nowMs()
+{
+  using namespace chrono;
+  return duration_cast<milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static string
+toLower(const string& s)
+{
+  string r=s;
+
+  for (auto& c: r)
+    c = static_cast<char>(std::tolower((unsigned char)c));
+  if (!r.empty() && r.back()=='.')
+    r.pop_back();
+  return r;
+}
+
+static string
+hexEncode(const vector<uint8_t>& v)
+{
+  static const char* H = "0123456789abcdef";
+  string out; out.reserve(v.size()*2);
+
+  for (auto b: v)
+  {
+    out.push_back(H[b>>4]);
+    out.push_back(H[b&0xF]);
+  }
+  return out;
+}
+
+static vector<uint8_t>
+hexDecode(const string& s)
+{
+  vector<uint8_t> out;
+  
+  if (s.size()%2)
+    return out;
+  out.reserve(s.size()/2);
+
+  auto val=[&](char c)->int
+  {
+    if (c>='0'&&c<='9') return c-'0';
+    if (c>='a'&&c<='f') return c-'a'+10;
+    if (c>='A'&&c<='F') return c-'A'+10;
+    return -1;
+  };
+
+  for (size_t i=0;i<s.size();i+=2)
+  {
+    int hi=val(s[i]), lo=val(s[i+1]);
+
+    if (hi<0||lo<0)
+    {
+      out.clear();
+      return out;
+    }
+    out.push_back(static_cast<uint8_t>((hi<<4)|lo));
+  }
+  return out;
+}
+
+// Estado de uma conexão: buffers de entrada/saída e um PUTP em andamento
+// (o PUTP ocupa várias linhas: cabeçalho + n linhas de RR).
+struct PendingPut
+{
+  bool active = false;
+  string name;
+  unsigned type = 0;
+  unsigned remaining = 0;
+  uint64_t now = 0;
+  PositiveEntry pe;
+};
+
+struct Conn
+{
+  int fd = -1;
+  string in;       // bytes recebidos ainda sem '\n'
+  string out;      // respostas ainda não enviadas
+  PendingPut put;
+  bool closing = false; // fecha depois de esvaziar out
+};
+
+static void
+reply(Conn& c, const string& line)
+{
+  c.out += line;
+  c.out.push_back('\n');
+}
+
+// Linha de RR de um PUTP em andamento
+static void
+process_put_line(Conn& c, const string& line)
+{
+  PendingPut& p = c.put;
+  istringstream is2(line);
+  unsigned t,c2,rrttl;
+  string hex;
+
+  if (!(is2>>t>>c2>>rrttl>>hex))
+  {
+    reply(c, "ERR bad RR line");
+    p = PendingPut{};
+    c.closing = true;
+    return;
+  }
+
+  RR r;
+
+  r.name = p.name;
+  r.type=(uint16_t)t;
+  r.rrclass=(uint16_t)c2;
+  r.ttl=rrttl;
+  r.rdata=hexDecode(hex);
+  p.pe.rrset.push_back(move(r));
+  if (--p.remaining == 0)
+  {
+    g_cache.putPositive(CacheKey{p.name,(uint16_t)p.type,1}, move(p.pe), p.now);
+    p = PendingPut{};
+    reply(c, "OK");
+  }
+}
+
+// Processa uma linha completa do protocolo de texto; respostas vão para c.out
+static void
+process_line(Conn& c, const string& line)
+{
+  if (c.put.active)
+  {
+    process_put_line(c, line);
+    return;
+  }
+
+  istringstream iss(line);
+  string cmd; iss >> cmd;
+
+  if (cmd.empty())
+  {
+    c.closing = true;
+    return;
+  }
+
+  if (cmd=="STATUS")
+  {
+    uint64_t now = nowMs();
+
+    g_cache.purgeExpired(now);
+    reply(c, "OK cache_daemon shards=" + to_string(g_cache.shardCount()) +
+             " pos=" + to_string(g_cache.positiveCount()) +
+             " neg=" + to_string(g_cache.negativeCount()));
+  }
+  else if (cmd=="GET")
+  {
+    string name;
+    unsigned type;
+
+    if (!(iss>>name>>type))
+    {
+      reply(c,"ERR bad GET");
+      return;
+    }
+    name = toLower(name);
+
+    CacheKey key{name, (uint16_t)type, 1};
+    uint64_t now = nowMs();
+
+    if (auto pos = g_cache.getPositive(key, now))
+    {
+      // POS <ttl_restante> <n>
+      uint32_t ttl = (pos->expires_at_ms>now)? (uint32_t)((pos->expires_at_ms-now)/1000):0;
+
+      reply(c, "POS "+to_string(ttl)+" "+to_string(pos->rrset.size()));
+      for (const auto& rr: pos->rrset)
+      {
+        reply(c, to_string(rr.type)+" "+to_string(rr.rrclass)+" "+to_string(rr.ttl)+" "+hexEncode(rr.rdata));
+      }
+    }
+    else if (auto neg = g_cache.getNegative(key, now))
+    {
+      uint32_t ttl = (neg->expires_at_ms>now)? (uint32_t)((neg->expires_at_ms-now)/1000):0;
+
+      reply(c, "NEG "+to_string(ttl)+" "+to_string(neg->rcode));
+    }
+    else
+    {
+      reply(c, "NOTFOUND");
+    }
+  }
+  else if (cmd=="PUTP")
+  {
+    string name;
+    unsigned type;
+    unsigned ttl;
+    unsigned n;
+
+    if (!(iss>>name>>type>>ttl>>n))
+    {
+      reply(c,"ERR bad PUTP");
+      return;
+    }
+
+    PendingPut& p = c.put;
+
+    p.name = toLower(name);
+    p.type = type;
+    p.now = nowMs();
+    p.pe.expires_at_ms = p.now + (uint64_t)ttl*1000ull;
+    p.pe.rcode = 0;
+    p.pe.rrset.reserve(n);
+    if (n == 0)
+    {
+      g_cache.putPositive(CacheKey{p.name,(uint16_t)type,1}, move(p.pe), p.now);
+      p = PendingPut{};
+      reply(c, "OK");
+      return;
+    }
+    p.remaining = n;
+    p.active = true;
+  }
+  else if (cmd=="PUTN")
+  {
+    string name;
+    unsigned type;
+    unsigned ttl;
+    unsigned rcode;
+
+    if (!(iss>>name>>type>>ttl>>rcode))
+    {
+      reply(c,"ERR bad PUTN");
+      return;
+    }
+    name = toLower(name);
+
+    NegativeEntry ne;
+    uint64_t now = nowMs();
+
+    ne.expires_at_ms = now + (uint64_t)ttl*1000ull;
+    ne.rcode = (uint16_t)rcode;
+    ne.kind = (rcode==3)? NegKind::NXDOMAIN : NegKind::NODATA;
+    g_cache.putNegative(CacheKey{name,(uint16_t)type,1}, move(ne), now);
+    reply(c, "OK");
+  }
+  else if (cmd=="QUIT" || cmd=="EXIT")
+  {
+    reply(c, "BYE");
+    c.closing = true;
+  }
+  else
+  {
+    reply(c, "ERR unknown");
+  }
+}
+
+// Separa as linhas completas de c.in e processa cada uma.
+// Retorna false se a linha pendente passou do limite.
+static bool
+consume_lines(Conn& c)
+{
+  size_t start = 0;
+
+  while (!c.closing)
+  {
+    size_t nl = c.in.find('\n', start);
+
+    if (nl == string::npos)
+      break;
+
+    size_t end = nl;
+
+    if (end > start && c.in[end-1] == '\r')
+      --end;
+    process_line(c, c.in.substr(start, end - start));
+    start = nl + 1;
+  }
+  c.in.erase(0, start);
+  return c.in.size() <= 8192;
+}
+
+static int
+open_listener(bool reuseport)
+{
+  int srv = ::socket(AF_INET, SOCK_STREAM, 0);
+
+  if (srv<0)
+  {
+    perror("socket");
+    return -1;
+  }
+
+  sockaddr_in addr{};
+  addr.sin_family=AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = htons(5353);
+
+  int yes=1;
+
+  setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, (char*)&yes, sizeof(yes));
+#ifdef SO_REUSEPORT
+  // Cada worker tem seu próprio socket de escuta; o kernel distribui as conexões
+  if (reuseport)
+    setsockopt(srv, SOL_SOCKET, SO_REUSEPORT, (char*)&yes, sizeof(yes));
+#else
+  (void)reuseport;
+#endif
+  if (bind(srv, (sockaddr*)&addr, sizeof(addr))!=0)
+  {
+    perror("bind 127.0.0.1:5353");
+    closesock(srv);
+    return -1;
+  }
+  if (listen(srv, 512)!=0)
+  {
+    perror("listen");
+    closesock(srv);
+    return -1;
+  }
+  return srv;
+}
+
+#ifdef __linux__
+
+// ---- Reactor epoll (edge-triggered), um por worker ----
+
+static void
+set_nonblock(int fd)
+{
+  int fl = fcntl(fd, F_GETFL, 0);
+
+  fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+// Envia o que der de c.out sem bloquear. false = erro (fechar).
+static bool
+flush_out(Conn& c)
+{
+  size_t off = 0;
+
+  while (off < c.out.size())
+  {
+    ssize_t w = ::send(c.fd, c.out.data() + off, c.out.size() - off, MSG_NOSIGNAL);
+
+    if (w > 0)
+    {
+      off += static_cast<size_t>(w);
+      continue;
+    }
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break; // EPOLLOUT avisa quando puder continuar
+    return false;
+  }
+  c.out.erase(0, off);
+  return true;
+}
+
+// Lê tudo que estiver disponível (ET exige ler até EAGAIN). false = fechar.
+static bool
+drain_in(Conn& c)
+{
+  char buf[16384];
+
+  while (true)
+  {
+    ssize_t r = ::recv(c.fd, buf, sizeof(buf), 0);
+
+    if (r > 0)
+    {
+      c.in.append(buf, static_cast<size_t>(r));
+      if (!consume_lines(c))
+        return false;
+      continue;
+    }
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return true;
+    return false; // 0 = peer fechou
+  }
+}
+
+static void
+worker_loop(int srv)
+{
+  int ep = epoll_create1(0);
+
+  if (ep < 0)
+  {
+    perror("epoll_create1");
+    return;
+  }
+
+  unordered_map<int, Conn> conns;
+  epoll_event ev{};
+
+  set_nonblock(srv);
+  ev.events = EPOLLIN;
+  ev.data.fd = srv;
+  epoll_ctl(ep, EPOLL_CTL_ADD, srv, &ev);
+
+  auto close_conn = [&](int fd)
+  {
+    epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+    closesock(fd);
+    conns.erase(fd);
+  };
+
+  epoll_event events[256];
+
+  while (running)
+  {
+    int n = epoll_wait(ep, events, 256, 1000);
+
+    if (n < 0 && errno != EINTR)
+      break;
+    for (int i = 0; i < n; ++i)
+    {
+      int fd = events[i].data.fd;
+
+      if (fd == srv)
+      {
+        // Aceita todas as conexões pendentes
+        while (true)
+        {
+          int cfd = ::accept4(srv, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+          if (cfd < 0)
+            break;
+
+          epoll_event cev{};
+
+          cev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+          cev.data.fd = cfd;
+          conns[cfd].fd = cfd;
+          epoll_ctl(ep, EPOLL_CTL_ADD, cfd, &cev);
+        }
+        continue;
+      }
+
+      auto it = conns.find(fd);
+
+      if (it == conns.end())
+        continue;
+
+      Conn& c = it->second;
+      bool ok = true;
+
+      if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        ok = drain_in(c);
+      if (!c.out.empty())
+        ok = flush_out(c) && ok;
+      if (!ok || (c.closing && c.out.empty()))
+        close_conn(fd);
+    }
+  }
+
+  for (auto& kv : conns)
+    closesock(kv.first);
+  closesock(ep);
+}
+
+#else
+
+// ---- Fallback portátil: uma thread por conexão (blocante) ----
+
+static void
+handle_client(int fd)
+{
+  Conn c;
+  char buf[4096];
+
+  c.fd = fd;
+  while (running && !c.closing)
+  {
+#ifdef _WIN32
+    int r = ::recv(fd, buf, (int)sizeof(buf), 0);
+#else
+    ssize_t r = ::recv(fd, buf, sizeof(buf), 0);
+#endif
+    if (r<=0)
+      break;
+    c.in.append(buf, (size_t)r);
+
+    bool ok = consume_lines(c);
+
+    if (!c.out.empty())
+    {
+      ::send(fd, c.out.data(), (int)c.out.size(), 0);
+      c.out.clear();
+    }
+    if (!ok)
+      break;
+  }
+  closesock(fd);
+}
+
+#endif
+
+int
+main(int, char**)
+{
+#ifdef _WIN32
+  WSADATA wsa; WSAStartup(MAKEWORD(2,2), &wsa);
+#endif
+
+#ifdef __linux__
+  // Um reactor por núcleo, cada um com seu socket de escuta (SO_REUSEPORT).
+  // O número de threads não depende mais do número de conexões.
+  unsigned nworkers = max(1u, thread::hardware_concurrency());
+  vector<int> listeners;
+
+  for (unsigned i = 0; i < nworkers; ++i)
+  {
+    int srv = open_listener(/*reuseport=*/true);
+
+    if (srv < 0)
+    {
+      if (listeners.empty())
+        return 2;
+      break; // segue com os que conseguiu abrir
+    }
+    listeners.push_back(srv);
+  }
+
+  fprintf(stderr, "[cache_daemon] listening on 127.0.0.1:5353 (%zu workers)\n", listeners.size());
+
+  vector<thread> workers;
+
+  for (int srv : listeners)
+    workers.emplace_back(worker_loop, srv);
+  for (auto& t : workers)
+    t.join();
+  for (int srv : listeners)
+    closesock(srv);
+#else
+  int srv = open_listener(/*reuseport=*/false);
+
+  if (srv<0)
+    return 2;
+
+  fprintf(stderr, "[cache_daemon] listening on 127.0.0.1:5353\n");
+
+  while (running)
+  {
+    sockaddr_in cli{};
+    socklen_t slen = sizeof(cli);
+    int fd = ::accept(srv, (sockaddr*)&cli, &slen);
+    if (fd<0)
+      continue;
+    thread(handle_client, fd).detach();
+  }
+  closesock(srv);
+#endif
+#ifdef _WIN32
+  WSACleanup();
+#endif
+  return 0;
+}
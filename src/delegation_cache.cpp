@@ -0,0 +1,105 @@
+#include "delegation_cache.h"
+#include <algorithm>
+
+bool
+isInZone(string_view name, string_view zone)
+{
+  if (zone.empty())
+    return true; // tudo está abaixo da raiz
+  if (name.size() < zone.size())
+    return false;
+  if (name.compare(name.size() - zone.size(), zone.size(), zone) != 0)
+    return false;
+  // igual, ou termina em ".zone"
+  return name.size() == zone.size() || name[name.size() - zone.size() - 1] == '.';
+}
+
+DelegationCache::DelegationCache(size_t capacity)
+  : capacity_(capacity) {}
+
+void
+DelegationCache::erase_(unordered_map<string, Node>::iterator it)
+{
+  lru_.erase(it->second.it_lru);
+  map_.erase(it);
+}
+
+optional<Delegation>
+DelegationCache::findClosest(string_view qname_norm, uint64_t now_ms)
+{
+  string_view cur = qname_norm;
+
+  while (true)
+  {
+    auto it = map_.find(string(cur));
+
+    if (it != map_.end())
+    {
+      if (now_ms >= it->second.d.expires_at_ms)
+      {
+        erase_(it);
+      }
+      else if (!it->second.d.ns_ips.empty())
+      {
+        lru_.splice(lru_.begin(), lru_, it->second.it_lru);
+        return it->second.d;
+      }
+    }
+    if (cur.empty())
+      break;
+
+    // Remove o rótulo mais à esquerda
+    size_t dot = cur.find('.');
+
+    cur = (dot == string_view::npos) ? string_view() : cur.substr(dot + 1);
+  }
+  return nullopt;
+}
+
+void
+DelegationCache::put(Delegation d)
+{
+  auto it = map_.find(d.zone);
+
+  if (it != map_.end())
+  {
+    // Mantém endereços já resolvidos se o novo referral veio sem glue
+    if (d.ns_ips.empty())
+      d.ns_ips = move(it->second.d.ns_ips);
+    it->second.d = move(d);
+    lru_.splice(lru_.begin(), lru_, it->second.it_lru);
+    return;
+  }
+
+  lru_.push_front(d.zone);
+
+  Node n;
+
+  n.it_lru = lru_.begin();
+
+  string zone = d.zone;
+
+  n.d = move(d);
+  map_.emplace(move(zone), move(n));
+
+  // Evicção simples por LRU
+  while (map_.size() > capacity_ && !lru_.empty())
+    erase_(map_.find(lru_.back()));
+}
+
+void
+DelegationCache::addAddresses(const string& zone, const vector<string>& ips, uint64_t now_ms)
+{
+  auto it = map_.find(zone);
+
+  if (it == map_.end() || now_ms >= it->second.d.expires_at_ms)
+    return;
+
+  auto& v = it->second.d.ns_ips;
+
+  for (const auto& ip : ips)
+  {
+    if (find(v.begin(), v.end(), ip) == v.end())
+      v.push_back(ip);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <list>
+#include <optional>
+#include <cstdint>
+
+using namespace std;
+
+// Corte de zona aprendido de um REFERRAL (NS + endereços dos NS)
+struct Delegation
+{
+  string zone;               // normalizado ("" = raiz), ex.: "com", "example.com"
+  vector<string> ns_names;   // nomes dos NS da zona
+  vector<string> ns_ips;     // glue ou endereços resolvidos depois
+  uint64_t expires_at_ms = 0;
+};
+
+// true se name está dentro de zone (igual ou subdomínio, em fronteira de rótulo)
+bool isInZone(string_view name, string_view zone);
+
+// Cache de delegações, chaveada pelo corte de zona.
+// Permite começar a iteração no corte mais próximo em vez da raiz.
+class DelegationCache
+{
+public:
+  explicit DelegationCache(size_t capacity = 512);
+
+  // Corte mais próximo que contém qname e que tenha endereços utilizáveis.
+  // Sobe rótulo a rótulo: "www.ufms.br" -> "ufms.br" -> "br" -> "".
+  optional<Delegation> findClosest(string_view qname_norm, uint64_t now_ms);
+
+  // Insere/substitui a delegação de d.zone
+  void put(Delegation d);
+
+  // Acrescenta endereços resolvidos (NS sem glue) a uma delegação existente
+  void addAddresses(const string& zone, const vector<string>& ips, uint64_t now_ms);
+
+  size_t size() const { return map_.size(); }
+
+private:
+  struct Node
+  {
+    Delegation d;
+    list<string>::iterator it_lru;
+  };
+
+  unordered_map<string, Node> map_;
+  list<string> lru_; // frente = mais recente
+  size_t capacity_;
+
+  void erase_(unordered_map<string, Node>::iterator it);
+};
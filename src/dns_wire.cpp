@@ -1,426 +1,589 @@
-#include "dns_wire.h"
-#include <algorithm>
-#include <random>
-#include <stdexcept>
-#include <arpa/inet.h> // em Linux. No Windows, esse helper não é usado (só formatação manual).
-
-// Helpers de leitura/escrita
-// Empurram um uint16_t e um uint32_t para o vetor em ordem de rede (BIG-ENDIAN)
-void
-push_u16(vector<uint8_t>& buf, uint16_t v)
-{
-  buf.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
-  buf.push_back(static_cast<uint8_t>(v & 0xFF));
-}
-
-void
-push_u32(vector<uint8_t>& buf, uint32_t v)
-{
-  buf.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
-  buf.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
-  buf.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
-  buf.push_back(static_cast<uint8_t>(v & 0xFF));
-}
-
-// – Lê uint16_t/uint32_t de b a partir de off (big-endian),
-// avança off e retorna false se não houver bytes suficientes.
-bool
-read_u16(const vector<uint8_t>& b, size_t& off, uint16_t& out)
-{
-  if (off + 2 > b.size())
-    return false;
-  out = (static_cast<uint16_t>(b[off]) << 8) | static_cast<uint16_t>(b[off+1]);
-  off += 2;
-  return true;
-}
-
-bool
-read_u32(const vector<uint8_t>& b, size_t& off, uint32_t& out)
-{
-  if (off + 4 > b.size())
-    return false;
-  out = (static_cast<uint32_t>(b[off])   << 24) |
-        (static_cast<uint32_t>(b[off+1]) << 16) |
-        (static_cast<uint32_t>(b[off+2]) << 8 ) |
-         static_cast<uint32_t>(b[off+3]);
-  off += 4;
-  return true;
-}
-
-// Converte "www.ufms.br" para [3]'www'[4]'ufms'[2]'br'[0]
-bool
-encode_name(const string& name, vector<uint8_t>& out)
-{
-  if (name.empty() || name == ".") // nomes vazios significam raiz
-  {
-    out.push_back(0);
-    return true;
-  }
-
-  size_t start = 0;
-
-  // Dividir o nome nos rótulos (entre pontos), escrever len e label pra cada,
-  // validar len <= 63 e terminar com 0
-  while (start < name.size())
-  {
-    size_t dot = name.find('.', start);
-    size_t end = (dot == string::npos) ? name.size() : dot;
-    size_t len = end - start;
-
-    if (len > 63)
-      return false; // rótulo DNS <= 63 bytes
-    out.push_back(static_cast<uint8_t>(len));
-    for (size_t i = start; i < end; ++i)
-      out.push_back(static_cast<uint8_t>(name[i]));
-    if (dot == string::npos) 
-      break;
-    start = dot + 1;
-  }
-  out.push_back(0); // terminador
-  return true;
-}
-
-// Decodificador de nomes: suporta compressão por ponteiros (RFC 1035).
-// cur é o cursor “real”; off é a posição do chamador (avança diferente quando há ponteiro).
-// jumped/jump_end controlam o retorno ao fluxo original após seguir um ponteiro.
-// jumps limita loops maliciosos (proteção).
-bool
-decode_name(const vector<uint8_t>& b, size_t& off, string& out)
-{
-  out.clear();
-
-  size_t cur = off;
-  bool jumped = false;
-  size_t jump_end = 0; // onde retomar se bater ponteiro
-  int jumps = 0; // Evitar loop de ponteiros maliciosos
-
-  // Evitar loop de ponteiros maliciosos
-  while (true)
-  {
-    if (cur >= b.size())
-      return false;
-
-    uint8_t len = b[cur];
-
-    // Ponteiro?
-    if ((len & 0xC0) == 0xC0)
-    {
-      if (cur + 1 >= b.size())
-        return false;
-
-      uint16_t ptr = ((static_cast<uint16_t>(len & 0x3F) << 8) |
-                      static_cast<uint16_t>(b[cur+1]));
-
-      if (!jumped)
-      {
-        jump_end = cur + 2; // onde continuar depois
-        jumped = true;
-      }
-      cur = ptr;
-      if (++jumps > 16)
-        return false; // proteção
-      continue;
-    }
-
-    // Fim do nome
-    if (len == 0)
-    {
-      cur += 1;
-      break;
-    }
-
-    // Label normal
-    if (cur + 1 + len > b.size())
-      return false;
-    if (!out.empty())
-      out.push_back('.');
-    for (size_t i = 0; i < len; ++i)
-      out.push_back(static_cast<char>(b[cur + 1 + i]));
-    cur += 1 + len;
-  }
-
-  // Avança o 'off' apenas se não houve salto; se houve, volta ao ponto após o ponteiro
-  off = jumped ? jump_end : cur;
-  return true;
-}
-
-// Prepara o buffer (capacidade inicial)
-vector<uint8_t>
-buildQuery(const string& qname, uint16_t qtype, bool use_edns)
-{
-  vector<uint8_t> buf;
-
-  buf.reserve(512);
-
-  // ID aleatório
-  static random_device rd;
-  static mt19937 gen(rd());
-  uint16_t id = static_cast<uint16_t>(gen());
-
-  // Flags: RD=0 (resolver iterativo), QR=0 (query)
-  uint16_t flags = 0x0000;
-  // Se depois quiser RD=1 para simular stub, trocar aqui (flags |= 0x0100).
-
-  // Teremos 1 Question. As outras seções ficam 0. Se use_edns, haverá 1 RR OPT na Additional.
-  uint16_t qdcount = 1;
-  uint16_t ancount = 0, nscount = 0, arcount = use_edns ? 1 : 0;
-
-  // Escreve o Header (12 bytes) no buffer
-  push_u16(buf, id);
-  push_u16(buf, flags);
-  push_u16(buf, qdcount);
-  push_u16(buf, ancount);
-  push_u16(buf, nscount);
-  push_u16(buf, arcount);
-
-  // Question
-  if (!encode_name(qname, buf))
-    throw runtime_error("encode_name: label > 63 bytes");
-  push_u16(buf, qtype);
-  push_u16(buf, 1 /*IN*/);
-
-  // EDNS(0) OPT RR (Additional)
-  if (use_edns)
-  {
-    // NAME = root (0)
-    buf.push_back(0x00);
-    // TYPE = 41 (OPT)
-    push_u16(buf, 41);
-    // CLASS = tamanho máximo de UDP aceito
-    // 1232 é um bom valor moderno para evitar fragmentação (padrão comum).
-    push_u16(buf, 1232);
-
-    // TTL (32 bits) = Extended RCODE (8) | EDNS Version (8) | Z flags (16)
-    push_u32(buf, 0);
-
-    // RDLENGTH = 0 (sem opções)
-    push_u16(buf, 0);
-  }
-
-  return buf; // Retorna os bytes da query prontos para enviar
-}
-
-// Lê QNAME, QTYPE, QCLASS. Usa decode_name (com ponteiros) e avança off
-static bool
-parse_question(const vector<uint8_t>& b, size_t& off, DnsQuestion& q)
-{
-  if (!decode_name(b, off, q.qname))
-    return false;
-  if (!read_u16(b, off, q.qtype))
-    return false;
-  if (!read_u16(b, off, q.qclass))
-    return false;
-  return true;
-}
-
-// Lê NAME (com compressão), TYPE, CLASS, TTL, RDLENGTH e copia os rdlen bytes de RDATA
-static bool
-parse_rr(const vector<uint8_t>& b, size_t& off, DnsRR& rr)
-{
-  if (!decode_name(b, off, rr.name))
-    return false;
-  if (!read_u16(b, off, rr.type))
-    return false;
-  if (!read_u16(b, off, rr.rrclass))
-    return false;
-  if (!read_u32(b, off, rr.ttl))
-    return false;
-
-  uint16_t rdlen = 0;
-
-  if (!read_u16(b, off, rdlen))
-    return false;
-
-  if (off + rdlen > b.size())
-    return false;
-  rr.rdata_offset = static_cast<uint32_t>(off); // onde o RDATA começa no wire
-  rr.rdata.assign(b.begin() + off, b.begin() + off + rdlen);
-  off += rdlen;
-  return true;
-}
-
-// Lê o Header (6 campos de 16 bits). Garante pelo menos 12 bytes no começo.
-bool
-parseMessage(const vector<uint8_t>& data, DnsMessage& out)
-{
-  out = {}; // limpa
-  out.wire = data; // guarda a mensagem bruta
-
-  if (data.size() < 12)
-    return false;
-  
-  size_t off = 0;
-
-  if (!read_u16(data, off, out.header.id))
-    return false;
-  if (!read_u16(data, off, out.header.flags))
-    return false;
-  if (!read_u16(data, off, out.header.qdcount))
-    return false;
-  if (!read_u16(data, off, out.header.ancount)) 
-    return false;
-  if (!read_u16(data, off, out.header.nscount))
-    return false;
-  if (!read_u16(data, off, out.header.arcount))
-    return false;
-
-  // Questions
-  out.questions.reserve(out.header.qdcount);
-  for (uint16_t i = 0; i < out.header.qdcount; ++i)
-  {
-    DnsQuestion q;
-
-    if (!parse_question(data, off, q))
-      return false;
-    out.questions.push_back(move(q));
-  }
-
-  // Answers
-  out.answers.reserve(out.header.ancount);
-  for (uint16_t i = 0; i < out.header.ancount; ++i)
-  {
-    DnsRR rr;
-
-    if (!parse_rr(data, off, rr))
-      return false;
-    out.answers.push_back(move(rr));
-  }
-
-  // Authority
-  out.authorities.reserve(out.header.nscount);
-  for (uint16_t i = 0; i < out.header.nscount; ++i)
-  {
-    DnsRR rr;
-
-    if (!parse_rr(data, off, rr))
-      return false;
-    out.authorities.push_back(move(rr));
-  }
-
-  // Additional
-  out.additionals.reserve(out.header.arcount);
-  for (uint16_t i = 0; i < out.header.arcount; ++i)
-  {
-    DnsRR rr;
-
-    if (!parse_rr(data, off, rr))
-      return false;
-    out.additionals.push_back(move(rr));
-  }
-
-  // Conclui o parse. Se sobrarem bytes, simplesmente ignoramos (tolerante).
-  return true;
-}
-
-string
-toLowerName(const string& s)
-{
-  string r = s;
-
-  transform(r.begin(), r.end(), r.begin(),
-                 [](unsigned char c){ return static_cast<char>(tolower(c)); });
-  if (!r.empty() && r.back() == '.')
-    r.pop_back();
-  return r;
-}
-
-string
-rdataToIPString(const DnsRR& rr)
-{
-  char buf[INET6_ADDRSTRLEN]{};
-
-  if (rr.type == dnstype::A && rr.rdata.size() == 4)
-  {
-    // IPv4
-    const uint8_t* p = rr.rdata.data();
-
-    // formatação manual para portabilidade (sem depender de inet_ntop)
-    return to_string(p[0]) + "." + to_string(p[1]) + "." +
-           to_string(p[2]) + "." + to_string(p[3]);
-  }
-  if (rr.type == dnstype::AAAA && rr.rdata.size() == 16)
-  {
-    const void* src = rr.rdata.data();
-
-#ifdef _WIN32
-    // fallback simples (hex sem compressão ::) se inet_ntop não estiver disponível:
-    const uint8_t* p = static_cast<const uint8_t*>(src);
-    string out;
-
-    for (int i = 0; i < 16; i += 2)
-    {
-      char chunk[5];
-
-      snprintf(chunk, sizeof(chunk), "%02x%02x", p[i], p[i+1]);
-      out += chunk;
-      if (i < 14)
-        out += ":";
-    }
-    return out;
-#else
-    if (::inet_ntop(AF_INET6, src, buf, sizeof(buf)))
-      return string(buf);
-    return "";
-#endif
-  }
-  return "";
-}
-
-// Decodifica um domain name começando NO INÍCIO do RDATA (para NS/CNAME).
-// Usa a mensagem original (msg.wire) e o offset rr.rdata_offset.
-// IMPORTANTE: decode_name precisa do buffer inteiro por causa de compressão.
-string rdataToDomainName(const DnsRR& rr, const DnsMessage& msg) {
-  // Só faz sentido para NS e CNAME
-  if (!(rr.type == dnstype::NS || rr.type == dnstype::CNAME))
-    return "";
-  if (rr.rdata.empty())
-    return "";
-
-  // Precisamos decodificar um NAME a partir do wire original,
-  // iniciando exatamente no começo do RDATA desse RR.
-  size_t off = static_cast<size_t>(rr.rdata_offset);
-  string out;
-
-  if (!decode_name(msg.wire, off, out))
-    return "";
-  return out;
-}
-
-
-// SOA: precisamos apenas do campo MINIMUM (último campo do SOA)
-pair<bool, uint32_t>
-
-rdataSOAMinimum(const DnsRR& rr, const DnsMessage& msg)
-{
-  if (rr.type != dnstype::SOA)
-    return {false, 0};
-  // SOA RDATA = MNAME (domain) | RNAME (domain) | SERIAL (u32) | REFRESH (u32)
-  //             | RETRY (u32) | EXPIRE (u32) | MINIMUM (u32)
-  
-  size_t off = rr.rdata_offset;
-  string tmp;
-
-  // Precisamos decodificar dois domain names em sequência:
-  // 1) MNAME
-  if (!decode_name(msg.wire, off, tmp))
-    return {false, 0};
-  // 2) RNAME
-  if (!decode_name(msg.wire, off, tmp))
-    return {false, 0};
-
-  // Agora vêm 5 campos u32:
-  uint32_t serial, refresh, retry, expire, minimum;
-
-  if (!read_u32(msg.wire, off, serial))
-    return {false, 0};
-  if (!read_u32(msg.wire, off, refresh))
-    return {false, 0};
-  if (!read_u32(msg.wire, off, retry))
-    return {false, 0};
-  if (!read_u32(msg.wire, off, expire))
-    return {false, 0};
-  if (!read_u32(msg.wire, off, minimum))
-    return {false, 0};
-
-  return {true, minimum};
-}
+#include "dns_wire.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <cctype>
+#include <cstdio>
+#include <arpa/inet.h> // em Linux. No Windows, esse helper não é usado (só formatação manual).
+
+// Helpers de leitura/escrita
+// Empurram um uint16_t e um uint32_t para o vetor em ordem de rede (BIG-ENDIAN)
+// (Buf: vector<uint8_t> ou pmr::vector<uint8_t>)
+template <class Buf>
+static void
+push_u16(Buf& buf, uint16_t v)
+{
+  buf.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
+  buf.push_back(static_cast<uint8_t>(v & 0xFF));
+}
+
+template <class Buf>
+static void
+push_u32(Buf& buf, uint32_t v)
+{
+  buf.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
+  buf.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
+  buf.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
+  buf.push_back(static_cast<uint8_t>(v & 0xFF));
+}
+
+// – Lê uint16_t/uint32_t de b (n bytes) a partir de off (big-endian),
+// avança off e retorna false se não houver bytes suficientes.
+static bool
+read_u16(const uint8_t* b, size_t n, size_t& off, uint16_t& out)
+{
+  if (off + 2 > n)
+    return false;
+  out = (static_cast<uint16_t>(b[off]) << 8) | static_cast<uint16_t>(b[off+1]);
+  off += 2;
+  return true;
+}
+
+static bool
+read_u32(const uint8_t* b, size_t n, size_t& off, uint32_t& out)
+{
+  if (off + 4 > n)
+    return false;
+  out = (static_cast<uint32_t>(b[off])   << 24) |
+        (static_cast<uint32_t>(b[off+1]) << 16) |
+        (static_cast<uint32_t>(b[off+2]) << 8 ) |
+         static_cast<uint32_t>(b[off+3]);
+  off += 4;
+  return true;
+}
+
+// Converte "www.ufms.br" para [3]'www'[4]'ufms'[2]'br'[0]
+template <class Buf>
+static bool
+encode_name(string_view name, Buf& out)
+{
+  if (name.empty() || name == ".") // nomes vazios significam raiz
+  {
+    out.push_back(0);
+    return true;
+  }
+
+  size_t start = 0;
+
+  // Dividir o nome nos rótulos (entre pontos), escrever len e label pra cada,
+  // validar len <= 63 e terminar com 0
+  while (start < name.size())
+  {
+    size_t dot = name.find('.', start);
+    size_t end = (dot == string_view::npos) ? name.size() : dot;
+    size_t len = end - start;
+
+    if (len > 63)
+      return false; // rótulo DNS <= 63 bytes
+    out.push_back(static_cast<uint8_t>(len));
+    for (size_t i = start; i < end; ++i)
+      out.push_back(static_cast<uint8_t>(name[i]));
+    if (dot == string_view::npos)
+      break;
+    start = dot + 1;
+  }
+  out.push_back(0); // terminador
+  return true;
+}
+
+// Decodificador de nomes: suporta compressão por ponteiros (RFC 1035).
+// cur é o cursor “real”; off é a posição do chamador (avança diferente quando há ponteiro).
+// jumped/jump_end controlam o retorno ao fluxo original após seguir um ponteiro.
+// jumps limita loops maliciosos (proteção).
+// Com out == nullptr apenas valida e pula o nome (sem alocar).
+template <class Str>
+static bool
+walk_name(const uint8_t* b, size_t n, size_t& off, Str* out)
+{
+  if (out)
+    out->clear();
+
+  size_t cur = off;
+  bool jumped = false;
+  size_t jump_end = 0; // onde retomar se bater ponteiro
+  int jumps = 0; // Evitar loop de ponteiros maliciosos
+
+  // Evitar loop de ponteiros maliciosos
+  while (true)
+  {
+    if (cur >= n)
+      return false;
+
+    uint8_t len = b[cur];
+
+    // Ponteiro?
+    if ((len & 0xC0) == 0xC0)
+    {
+      if (cur + 1 >= n)
+        return false;
+
+      uint16_t ptr = ((static_cast<uint16_t>(len & 0x3F) << 8) |
+                      static_cast<uint16_t>(b[cur+1]));
+
+      if (!jumped)
+      {
+        jump_end = cur + 2; // onde continuar depois
+        jumped = true;
+      }
+      cur = ptr;
+      if (++jumps > 16)
+        return false; // proteção
+      continue;
+    }
+
+    // Fim do nome
+    if (len == 0)
+    {
+      cur += 1;
+      break;
+    }
+
+    // Label normal
+    if (cur + 1 + len > n)
+      return false;
+    if (out)
+    {
+      if (!out->empty())
+        out->push_back('.');
+      out->append(reinterpret_cast<const char*>(b + cur + 1), len);
+    }
+    cur += 1 + len;
+  }
+
+  // Avança o 'off' apenas se não houve salto; se houve, volta ao ponto após o ponteiro
+  off = jumped ? jump_end : cur;
+  return true;
+}
+
+// Compara o nome em off (com ponteiros) com name_norm ("a.b.c", sem ponto final),
+// rótulo a rótulo e sem diferenciar maiúsculas. Não aloca.
+static bool
+name_equals(const uint8_t* b, size_t n, size_t off, string_view name_norm)
+{
+  size_t pos = 0;
+  int jumps = 0;
+
+  while (true)
+  {
+    if (off >= n)
+      return false;
+
+    uint8_t len = b[off];
+
+    if ((len & 0xC0) == 0xC0)
+    {
+      if (off + 1 >= n)
+        return false;
+      off = (static_cast<size_t>(len & 0x3F) << 8) | b[off+1];
+      if (++jumps > 16)
+        return false;
+      continue;
+    }
+    if (len == 0)
+      return pos == name_norm.size();
+    if (off + 1 + len > n)
+      return false;
+    if (pos > 0)
+    {
+      if (pos >= name_norm.size() || name_norm[pos] != '.')
+        return false;
+      ++pos;
+    }
+    if (pos + len > name_norm.size())
+      return false;
+    for (size_t i = 0; i < len; ++i)
+    {
+      if (tolower(b[off + 1 + i]) != tolower(static_cast<unsigned char>(name_norm[pos + i])))
+        return false;
+    }
+    pos += len;
+    off += 1 + len;
+  }
+}
+
+// Escreve Header + Question [+ OPT] em buf (já limpo pelo chamador)
+template <class Buf>
+static void
+build_query(Buf& buf, string_view qname, uint16_t qtype, bool use_edns)
+{
+  // ID aleatório
+  static random_device rd;
+  static mt19937 gen(rd());
+  uint16_t id = static_cast<uint16_t>(gen());
+
+  // Flags: RD=0 (resolver iterativo), QR=0 (query)
+  uint16_t flags = 0x0000;
+  // Se depois quiser RD=1 para simular stub, trocar aqui (flags |= 0x0100).
+
+  // Teremos 1 Question. As outras seções ficam 0. Se use_edns, haverá 1 RR OPT na Additional.
+  uint16_t qdcount = 1;
+  uint16_t ancount = 0, nscount = 0, arcount = use_edns ? 1 : 0;
+
+  // Escreve o Header (12 bytes) no buffer
+  push_u16(buf, id);
+  push_u16(buf, flags);
+  push_u16(buf, qdcount);
+  push_u16(buf, ancount);
+  push_u16(buf, nscount);
+  push_u16(buf, arcount);
+
+  // Question
+  if (!encode_name(qname, buf))
+    throw runtime_error("encode_name: label > 63 bytes");
+  push_u16(buf, qtype);
+  push_u16(buf, 1 /*IN*/);
+
+  // EDNS(0) OPT RR (Additional)
+  if (use_edns)
+  {
+    // NAME = root (0)
+    buf.push_back(0x00);
+    // TYPE = 41 (OPT)
+    push_u16(buf, 41);
+    // CLASS = tamanho máximo de UDP aceito
+    // 1232 é um bom valor moderno para evitar fragmentação (padrão comum).
+    push_u16(buf, 1232);
+
+    // TTL (32 bits) = Extended RCODE (8) | EDNS Version (8) | Z flags (16)
+    push_u32(buf, 0);
+
+    // RDLENGTH = 0 (sem opções)
+    push_u16(buf, 0);
+  }
+}
+
+// Prepara o buffer (capacidade inicial)
+vector<uint8_t>
+buildQuery(const string& qname, uint16_t qtype, bool use_edns)
+{
+  vector<uint8_t> buf;
+
+  buf.reserve(512);
+  build_query(buf, qname, qtype, use_edns);
+  return buf; // Retorna os bytes da query prontos para enviar
+}
+
+void
+buildQueryInto(pmr::vector<uint8_t>& out, string_view qname, uint16_t qtype, bool use_edns)
+{
+  out.clear();
+  out.reserve(512);
+  build_query(out, qname, qtype, use_edns);
+}
+
+// Lê o Header (6 campos de 16 bits) e percorre Q/RR guardando só offsets.
+bool
+DnsMessageView::parse(const uint8_t* data, size_t size)
+{
+  data_ = data;
+  size_ = size;
+  header_ = {};
+  questions_.clear();
+  rrs_.clear();
+
+  if (size < 12)
+    return false;
+
+  size_t off = 0;
+  DnsHeader h;
+
+  if (!read_u16(data, size, off, h.id) ||
+      !read_u16(data, size, off, h.flags) ||
+      !read_u16(data, size, off, h.qdcount) ||
+      !read_u16(data, size, off, h.ancount) ||
+      !read_u16(data, size, off, h.nscount) ||
+      !read_u16(data, size, off, h.arcount))
+    return false;
+
+  // Questions: QNAME (pulado), QTYPE, QCLASS
+  questions_.reserve(h.qdcount);
+  for (uint16_t i = 0; i < h.qdcount; ++i)
+  {
+    DnsQuestionView q;
+
+    q.name_offset = static_cast<uint32_t>(off);
+    if (!walk_name<string>(data, size, off, nullptr))
+      return false;
+    if (!read_u16(data, size, off, q.qtype))
+      return false;
+    if (!read_u16(data, size, off, q.qclass))
+      return false;
+    questions_.push_back(q);
+  }
+
+  // Answer/Authority/Additional: NAME (pulado), TYPE, CLASS, TTL, RDLENGTH, RDATA (pulado)
+  const size_t total = static_cast<size_t>(h.ancount) + h.nscount + h.arcount;
+
+  rrs_.reserve(total);
+  for (size_t i = 0; i < total; ++i)
+  {
+    DnsRRView rr;
+
+    rr.name_offset = static_cast<uint32_t>(off);
+    if (!walk_name<string>(data, size, off, nullptr))
+      return false;
+    if (!read_u16(data, size, off, rr.type))
+      return false;
+    if (!read_u16(data, size, off, rr.rrclass))
+      return false;
+    if (!read_u32(data, size, off, rr.ttl))
+      return false;
+    if (!read_u16(data, size, off, rr.rdlength))
+      return false;
+    if (off + rr.rdlength > size)
+      return false;
+    rr.rdata_offset = static_cast<uint32_t>(off); // onde o RDATA começa no wire
+    off += rr.rdlength;
+    rrs_.push_back(rr);
+  }
+
+  // Conclui o parse. Se sobrarem bytes, simplesmente ignoramos (tolerante).
+  header_ = h;
+  return true;
+}
+
+pmr::string
+DnsMessageView::name(uint32_t off, const dns_allocator& a) const
+{
+  size_t o = off;
+  pmr::string out(a);
+
+  if (!walk_name(data_, size_, o, &out))
+    out.clear();
+  return out;
+}
+
+bool
+DnsMessageView::nameEquals(uint32_t off, string_view name_norm) const
+{
+  return name_equals(data_, size_, off, name_norm);
+}
+
+pmr::string
+DnsMessageView::rdataDomainName(const DnsRRView& rr, const dns_allocator& a) const
+{
+  if (!(rr.type == dnstype::NS || rr.type == dnstype::CNAME) || rr.rdlength == 0)
+    return pmr::string(a);
+  return name(rr.rdata_offset, a);
+}
+
+pmr::string
+DnsMessageView::rdataIP(const DnsRRView& rr, const dns_allocator& a) const
+{
+  char buf[INET6_ADDRSTRLEN]{};
+  const uint8_t* p = data_ + rr.rdata_offset;
+
+  if (rr.type == dnstype::A && rr.rdlength == 4)
+  {
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", p[0], p[1], p[2], p[3]);
+    return pmr::string(buf, a);
+  }
+#ifndef _WIN32
+  if (rr.type == dnstype::AAAA && rr.rdlength == 16 &&
+      ::inet_ntop(AF_INET6, p, buf, sizeof(buf)))
+    return pmr::string(buf, a);
+#else
+  if (rr.type == dnstype::AAAA && rr.rdlength == 16)
+    return pmr::string(rdataToIPString(materialize(rr)), a);
+#endif
+  return pmr::string(a);
+}
+
+pair<bool, uint32_t>
+DnsMessageView::rdataSOAMinimum(const DnsRRView& rr) const
+{
+  if (rr.type != dnstype::SOA)
+    return {false, 0};
+
+  // MNAME, RNAME e depois SERIAL..EXPIRE (4 x u32); MINIMUM é o 5º u32
+  size_t off = rr.rdata_offset;
+  uint32_t minimum = 0;
+
+  if (!walk_name<string>(data_, size_, off, nullptr) ||
+      !walk_name<string>(data_, size_, off, nullptr))
+    return {false, 0};
+  off += 16;
+  if (!read_u32(data_, size_, off, minimum))
+    return {false, 0};
+  return {true, minimum};
+}
+
+DnsRR
+DnsMessageView::materialize(const DnsRRView& v, const dns_allocator& a) const
+{
+  DnsRR rr(a);
+
+  rr.name = name(v.name_offset, a);
+  rr.type = v.type;
+  rr.rrclass = v.rrclass;
+  rr.ttl = v.ttl;
+  rr.rdata.assign(data_ + v.rdata_offset, data_ + v.rdata_offset + v.rdlength);
+  rr.rdata_offset = v.rdata_offset;
+  return rr;
+}
+
+// Versão "dona": faz o parse pela view e materializa tudo em DnsMessage.
+bool
+parseMessage(const vector<uint8_t>& data, DnsMessage& out)
+{
+  // limpa (mantendo o alocador de out)
+  out.header = {};
+  out.questions.clear();
+  out.answers.clear();
+  out.authorities.clear();
+  out.additionals.clear();
+  out.wire.assign(data.begin(), data.end()); // guarda a mensagem bruta
+
+  auto alloc = out.wire.get_allocator();
+  DnsMessageView v(alloc);
+
+  if (!v.parse(out.wire.data(), out.wire.size()))
+    return false;
+
+  out.header = v.header();
+
+  out.questions.reserve(v.questions().size());
+  for (const auto& qv : v.questions())
+  {
+    DnsQuestion q(alloc);
+
+    q.qname = v.name(qv.name_offset, alloc);
+    q.qtype = qv.qtype;
+    q.qclass = qv.qclass;
+    out.questions.push_back(move(q));
+  }
+
+  out.answers.reserve(v.answers().size());
+  for (const auto& rr : v.answers())
+    out.answers.push_back(v.materialize(rr, alloc));
+  out.authorities.reserve(v.authorities().size());
+  for (const auto& rr : v.authorities())
+    out.authorities.push_back(v.materialize(rr, alloc));
+  out.additionals.reserve(v.additionals().size());
+  for (const auto& rr : v.additionals())
+    out.additionals.push_back(v.materialize(rr, alloc));
+  return true;
+}
+
+string
+toLowerName(const string& s)
+{
+  string r = s;
+
+  transform(r.begin(), r.end(), r.begin(),
+                 [](unsigned char c){ return static_cast<char>(tolower(c)); });
+  if (!r.empty() && r.back() == '.')
+    r.pop_back();
+  return r;
+}
+
+void
+toLowerNameInPlace(pmr::string& s)
+{
+  for (auto& c : s)
+    c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  if (!s.empty() && s.back() == '.')
+    s.pop_back();
+}
+
+string
+rdataToIPString(const DnsRR& rr)
+{
+  char buf[INET6_ADDRSTRLEN]{};
+
+  if (rr.type == dnstype::A && rr.rdata.size() == 4)
+  {
+    // IPv4
+    const uint8_t* p = rr.rdata.data();
+
+    // formatação manual para portabilidade (sem depender de inet_ntop)
+    return to_string(p[0]) + "." + to_string(p[1]) + "." +
+           to_string(p[2]) + "." + to_string(p[3]);
+  }
+  if (rr.type == dnstype::AAAA && rr.rdata.size() == 16)
+  {
+    const void* src = rr.rdata.data();
+
+#ifdef _WIN32
+    // fallback simples (hex sem compressão ::) se inet_ntop não estiver disponível:
+    const uint8_t* p = static_cast<const uint8_t*>(src);
+    string out;
+
+    for (int i = 0; i < 16; i += 2)
+    {
+      char chunk[5];
+
+      snprintf(chunk, sizeof(chunk), "%02x%02x", p[i], p[i+1]);
+      out += chunk;
+      if (i < 14)
+        out += ":";
+    }
+    return out;
+#else
+    if (::inet_ntop(AF_INET6, src, buf, sizeof(buf)))
+      return string(buf);
+    return "";
+#endif
+  }
+  return "";
+}
+
+// Decodifica um domain name começando NO INÍCIO do RDATA (para NS/CNAME).
+// Usa a mensagem original (msg.wire) e o offset rr.rdata_offset.
+// IMPORTANTE: decode_name precisa do buffer inteiro por causa de compressão.
+string rdataToDomainName(const DnsRR& rr, const DnsMessage& msg) {
+  // Só faz sentido para NS e CNAME
+  if (!(rr.type == dnstype::NS || rr.type == dnstype::CNAME))
+    return "";
+  if (rr.rdata.empty())
+    return "";
+
+  // Precisamos decodificar um NAME a partir do wire original,
+  // iniciando exatamente no começo do RDATA desse RR.
+  size_t off = static_cast<size_t>(rr.rdata_offset);
+  string out;
+
+  if (!walk_name(msg.wire.data(), msg.wire.size(), off, &out))
+    return "";
+  return out;
+}
+
+
+// SOA: precisamos apenas do campo MINIMUM (último campo do SOA)
+pair<bool, uint32_t>
+
+rdataSOAMinimum(const DnsRR& rr, const DnsMessage& msg)
+{
+  if (rr.type != dnstype::SOA)
+    return {false, 0};
+  // SOA RDATA = MNAME (domain) | RNAME (domain) | SERIAL (u32) | REFRESH (u32)
+  //             | RETRY (u32) | EXPIRE (u32) | MINIMUM (u32)
+  
+  size_t off = rr.rdata_offset;
+  const uint8_t* w = msg.wire.data();
+  const size_t wn = msg.wire.size();
+
+  // Precisamos decodificar dois domain names em sequência:
+  // 1) MNAME
+  if (!walk_name<string>(w, wn, off, nullptr))
+    return {false, 0};
+  // 2) RNAME
+  if (!walk_name<string>(w, wn, off, nullptr))
+    return {false, 0};
+
+  // Agora vêm 5 campos u32:
+  uint32_t serial, refresh, retry, expire, minimum;
+
+  if (!read_u32(w, wn, off, serial))
+    return {false, 0};
+  if (!read_u32(w, wn, off, refresh))
+    return {false, 0};
+  if (!read_u32(w, wn, off, retry))
+    return {false, 0};
+  if (!read_u32(w, wn, off, expire))
+    return {false, 0};
+  if (!read_u32(w, wn, off, minimum))
+    return {false, 0};
+
+  return {true, minimum};
+}
@@ -1,82 +1,217 @@
-#pragma once
-#include <cstdint>
-#include <string>
-#include <vector>
-
-using namespace std;
-
-// Cabeçalho DNS
-struct DnsHeader
-{
-  uint16_t id = 0;
-  uint16_t flags = 0;     // QR|Opcode|AA|TC|RD|RA|Z|RCODE
-  uint16_t qdcount = 0;   // Contadores de seções: Questions, Answers,
-  uint16_t ancount = 0;   // Authority (NS), Aditional (AR)
-  uint16_t nscount = 0;
-  uint16_t arcount = 0;
-};
-
-// Questão da query
-struct DnsQuestion
-{
-  string qname;      // nome “humano”
-  uint16_t qtype = 1;     // A=1, AAAA=28, ...
-  uint16_t qclass = 1;    // IN=1
-};
-
-// RR genérico (para parse e posterior mapeamento p/ cache)
-struct DnsRR
-{
-  string name;
-  uint16_t type = 1;
-  uint16_t rrclass = 1; // IN=1
-  uint32_t ttl = 0;
-  vector<uint8_t> rdata; // bytes crus
-  uint32_t rdata_offset = 0;  // offset do RDATA na mensagem original
-};
-
-// Mensagem DNS, separando cada seção
-struct DnsMessage
-{
-  DnsHeader header;
-  vector<DnsQuestion> questions;
-  vector<DnsRR> answers;
-  vector<DnsRR> authorities;
-  vector<DnsRR> additionals;
-  vector<uint8_t> wire; // c;opia da mensagem bruta
-};
-
-// Monta uma query DNS (Header + Question [+ OPT/EDNS])
-// use_edns = true adiciona RR OPT (type=41) para payload UDP maior.
-vector<uint8_t> buildQuery(const string& qname,
-                                uint16_t qtype,
-                                bool use_edns);
-
-// Faz o parse de uma mensagem DNS completa (Header, Q, RR).
-// Retorna false se houver erro óbvio (buffer curto, etc).
-bool parseMessage(const vector<uint8_t>& data, DnsMessage& out);
-
-// Normaliza nome: lower-case e sem ponto final.
-string toLowerName(const string& name);
-
-// Constantes úteis
-namespace dnstype
-{
-  constexpr uint16_t A = 1;
-  constexpr uint16_t NS = 2;
-  constexpr uint16_t CNAME = 5;
-  constexpr uint16_t SOA = 6;
-  constexpr uint16_t MX = 15;
-  constexpr uint16_t TXT = 16;
-  constexpr uint16_t AAAA = 28;
-}
-
-// Converte RDATA de A/AAAA para string ("1.2.3.4" ou "::1"). Retorna "" se tipo não bater.
-string rdataToIPString(const DnsRR& rr);
-
-// Decodifica um NAME (com compressão) a partir do início do RDATA (para NS/CNAME).
-// Retorna "" se tipo não bater ou se falhar.
-string rdataToDomainName(const DnsRR& rr, const DnsMessage& msg);
-
-// Extrai SOA.MINIMUM (TTL negativo sugerido pela RFC 2308). Retorna {ok, minimum}.
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory_resource>
+#include <string_view>
+
+using namespace std;
+
+// Cabeçalho DNS
+struct DnsHeader
+{
+  uint16_t id = 0;
+  uint16_t flags = 0;     // QR|Opcode|AA|TC|RD|RA|Z|RCODE
+  uint16_t qdcount = 0;   // Contadores de seções: Questions, Answers,
+  uint16_t ancount = 0;   // Authority (NS), Aditional (AR)
+  uint16_t nscount = 0;
+  uint16_t arcount = 0;
+};
+
+// As estruturas de parse usam alocadores pmr: por padrão caem no heap
+// global, mas podem ser construídas sobre uma arena (ver arena.h).
+using dns_allocator = pmr::polymorphic_allocator<char>;
+
+// Questão da query
+struct DnsQuestion
+{
+  using allocator_type = dns_allocator;
+
+  pmr::string qname;      // nome “humano”
+  uint16_t qtype = 1;     // A=1, AAAA=28, ...
+  uint16_t qclass = 1;    // IN=1
+
+  DnsQuestion() = default;
+  explicit DnsQuestion(const allocator_type& a) : qname(a) {}
+  DnsQuestion(const DnsQuestion& o, const allocator_type& a)
+    : qname(o.qname, a), qtype(o.qtype), qclass(o.qclass) {}
+  DnsQuestion(DnsQuestion&& o, const allocator_type& a)
+    : qname(move(o.qname), a), qtype(o.qtype), qclass(o.qclass) {}
+  DnsQuestion(const DnsQuestion&) = default;
+  DnsQuestion(DnsQuestion&&) = default;
+  DnsQuestion& operator=(const DnsQuestion&) = default;
+  DnsQuestion& operator=(DnsQuestion&&) = default;
+};
+
+// RR genérico (para parse e posterior mapeamento p/ cache)
+struct DnsRR
+{
+  using allocator_type = dns_allocator;
+
+  pmr::string name;
+  uint16_t type = 1;
+  uint16_t rrclass = 1; // IN=1
+  uint32_t ttl = 0;
+  pmr::vector<uint8_t> rdata; // bytes crus
+  uint32_t rdata_offset = 0;  // offset do RDATA na mensagem original
+
+  DnsRR() = default;
+  explicit DnsRR(const allocator_type& a) : name(a), rdata(a) {}
+  DnsRR(const DnsRR& o, const allocator_type& a)
+    : name(o.name, a), type(o.type), rrclass(o.rrclass), ttl(o.ttl),
+      rdata(o.rdata, a), rdata_offset(o.rdata_offset) {}
+  DnsRR(DnsRR&& o, const allocator_type& a)
+    : name(move(o.name), a), type(o.type), rrclass(o.rrclass), ttl(o.ttl),
+      rdata(move(o.rdata), a), rdata_offset(o.rdata_offset) {}
+  DnsRR(const DnsRR&) = default;
+  DnsRR(DnsRR&&) = default;
+  DnsRR& operator=(const DnsRR&) = default;
+  DnsRR& operator=(DnsRR&&) = default;
+};
+
+// Mensagem DNS, separando cada seção
+struct DnsMessage
+{
+  using allocator_type = dns_allocator;
+
+  DnsHeader header;
+  pmr::vector<DnsQuestion> questions;
+  pmr::vector<DnsRR> answers;
+  pmr::vector<DnsRR> authorities;
+  pmr::vector<DnsRR> additionals;
+  pmr::vector<uint8_t> wire; // cópia da mensagem bruta
+
+  DnsMessage() = default;
+  explicit DnsMessage(const allocator_type& a)
+    : questions(a), answers(a), authorities(a), additionals(a), wire(a) {}
+};
+
+// Monta uma query DNS (Header + Question [+ OPT/EDNS])
+// use_edns = true adiciona RR OPT (type=41) para payload UDP maior.
+vector<uint8_t> buildQuery(const string& qname,
+                                uint16_t qtype,
+                                bool use_edns);
+
+// Mesma query, escrita em out (que mantém o alocador/capacidade do chamador).
+void buildQueryInto(pmr::vector<uint8_t>& out,
+                    string_view qname,
+                    uint16_t qtype,
+                    bool use_edns);
+
+// Faz o parse de uma mensagem DNS completa (Header, Q, RR).
+// Retorna false se houver erro óbvio (buffer curto, etc).
+bool parseMessage(const vector<uint8_t>& data, DnsMessage& out);
+
+// ---- Visão sem cópia ----
+
+// Questão vista no buffer: só o offset do QNAME
+struct DnsQuestionView
+{
+  uint32_t name_offset = 0;
+  uint16_t qtype = 1;
+  uint16_t qclass = 1;
+};
+
+// RR visto no buffer: offsets do NAME e do RDATA, campos fixos já lidos
+struct DnsRRView
+{
+  uint32_t name_offset = 0;   // início do NAME (pode conter ponteiros)
+  uint16_t type = 1;
+  uint16_t rrclass = 1;
+  uint32_t ttl = 0;
+  uint32_t rdata_offset = 0;
+  uint16_t rdlength = 0;
+};
+
+// Faixa contígua de RRs (uma seção)
+struct DnsRRRange
+{
+  const DnsRRView* first = nullptr;
+  const DnsRRView* last = nullptr;
+
+  const DnsRRView* begin() const { return first; }
+  const DnsRRView* end() const { return last; }
+  size_t size() const { return static_cast<size_t>(last - first); }
+  bool empty() const { return first == last; }
+  const DnsRRView& operator[](size_t i) const { return first[i]; }
+};
+
+// Mensagem DNS vista sobre um buffer emprestado (não copia o pacote).
+// Guarda apenas offsets; nomes e RDATA são decodificados sob demanda.
+// O buffer precisa continuar vivo enquanto a view for usada.
+// Reusar a mesma view entre parses mantém a capacidade dos vetores internos.
+class DnsMessageView
+{
+public:
+  explicit DnsMessageView(const dns_allocator& a = {}) : questions_(a), rrs_(a) {}
+
+  bool parse(const uint8_t* data, size_t size);
+  bool parse(const vector<uint8_t>& data) { return parse(data.data(), data.size()); }
+
+  const DnsHeader& header() const { return header_; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  const pmr::vector<DnsQuestionView>& questions() const { return questions_; }
+  DnsRRRange answers() const { return range_(0, header_.ancount); }
+  DnsRRRange authorities() const { return range_(header_.ancount, header_.nscount); }
+  DnsRRRange additionals() const { return range_(header_.ancount + header_.nscount, header_.arcount); }
+
+  // Decodifica o nome que começa em off ("" se falhar)
+  pmr::string name(uint32_t off, const dns_allocator& a = {}) const;
+
+  // Compara (sem alocar) o nome em off com um nome normalizado
+  bool nameEquals(uint32_t off, string_view name_norm) const;
+
+  // NS/CNAME: nome no início do RDATA ("" se tipo não bater)
+  pmr::string rdataDomainName(const DnsRRView& rr, const dns_allocator& a = {}) const;
+
+  // A/AAAA: endereço em texto ("" se tipo não bater)
+  pmr::string rdataIP(const DnsRRView& rr, const dns_allocator& a = {}) const;
+
+  // SOA.MINIMUM. Retorna {ok, minimum}.
+  pair<bool, uint32_t> rdataSOAMinimum(const DnsRRView& rr) const;
+
+  // Cria a cópia "dona" de um RR (nome decodificado, RDATA copiado)
+  DnsRR materialize(const DnsRRView& rr, const dns_allocator& a = {}) const;
+
+private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  DnsHeader header_;
+  pmr::vector<DnsQuestionView> questions_;
+  pmr::vector<DnsRRView> rrs_; // answers | authorities | additionals, em ordem
+
+  DnsRRRange range_(size_t first, size_t count) const
+  {
+    return { rrs_.data() + first, rrs_.data() + first + count };
+  }
+};
+
+// Normaliza nome: lower-case e sem ponto final.
+string toLowerName(const string& name);
+
+// Mesma normalização, no próprio buffer (sem alocar).
+void toLowerNameInPlace(pmr::string& name);
+
+// Constantes úteis
+namespace dnstype
+{
+  constexpr uint16_t A = 1;
+  constexpr uint16_t NS = 2;
+  constexpr uint16_t CNAME = 5;
+  constexpr uint16_t SOA = 6;
+  constexpr uint16_t MX = 15;
+  constexpr uint16_t TXT = 16;
+  constexpr uint16_t AAAA = 28;
+}
+
+// Converte RDATA de A/AAAA para string ("1.2.3.4" ou "::1"). Retorna "" se tipo não bater.
+string rdataToIPString(const DnsRR& rr);
+
+// Decodifica um NAME (com compressão) a partir do início do RDATA (para NS/CNAME).
+// Retorna "" se tipo não bater ou se falhar.
+string rdataToDomainName(const DnsRR& rr, const DnsMessage& msg);
+
+// Extrai SOA.MINIMUM (TTL negativo sugerido pela RFC 2308). Retorna {ok, minimum}.
 pair<bool, uint32_t> rdataSOAMinimum(const DnsRR& rr, const DnsMessage& msg);
\ No newline at end of file
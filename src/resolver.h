@@ -1,139 +1,171 @@
-#pragma once
-#include <string>
-#include <optional>
-#include <cstdint>
-#include <vector>
-#include <unordered_set>
-#include <cstdarg>
-#include "cache.h"
-#include "dns_wire.h"
-#include "cache_client.h"
-#include "transport_tls.h"
-
-// Resultado final "alto nível" para o modo iterativo + cache
-struct ResolveResult
-{
-  enum class Kind { OK, NXDOMAIN, NODATA, ERROR } kind = Kind::ERROR;
-  uint32_t ttl = 0;            // TTL efetivo (segundos)
-  vector<RR> rrset;            // RRset final quando OK
-  uint16_t rcode = 0;          // RCODE da última resposta analisada
-};
-
-// Resultado da consulta “1 salto” (direto ao NS), útil para debug
-struct SingleQueryResult
-{
-  bool ok = false;
-  bool via_tcp = false;     // true quando usou TCP (ou TLS/DoT)
-  uint16_t rcode = 0;
-  DnsMessage message;       // já parseada
-};
-
-class Resolver
-{
-public:
-  Resolver() = default;
-
-  // ---- DoT/DNS mode ----
-  enum class Mode { DNS, DOT };
-  void setMode(Mode m) { mode_ = m; }
-  void setSNI(const string& s) { sni_ = s; }
-  void setDotInsecure(bool b) { dot_insecure_ = b; }
-
-  // Ativa/desativa trace no console (stderr)
-  void setTrace(bool on) { trace_ = on; }
-
-  // Consulta direta (1 salto): 
-  // - DNS: UDP e fallback TCP se TC=1
-  // - DoT: TLS/853 com SNI e validação de certificado
-  optional<SingleQueryResult> singleQueryTo(const string& ns_ip,
-                                            const string& qname,
-                                            const string& qtype,
-                                            bool use_edns = true,
-                                            int timeout_ms = 3000);
-
-  // Resolução iterativa + cache (começa do NS informado; idealmente um root)
-  optional<ResolveResult> resolveRecursive(const string& start_ns_ip,
-                                            const string& qname_in,
-                                            const string& qtype_in,
-                                            bool use_edns = true,
-                                            int timeout_ms = 3000);
-
-private:
-  DnsCache cache_{50, 50};
-  bool trace_ = false;
-
-  // modo de transporte
-  Mode mode_ = Mode::DNS;
-  string sni_;
-  bool dot_insecure_ = false;
-
-  // cache daemon (opcional): se disponível, preferimos ele
-  CacheDaemonClient daemon_;
-  bool tried_daemon_ = false;
-
-  // ------------ Helpers básicos ------------
-  uint16_t parseType(const string& qtype);
-  uint64_t nowMs() const;
-
-  vector<uint8_t> buildQueryBytes(const string& qname, uint16_t qtype, bool use_edns) const;
-  bool sendOnce(const string& ns_ip,
-                const vector<uint8_t>& q,
-                int timeout_ms,
-                DnsMessage& out,
-                bool& via_tcp);
-
-  static uint16_t getRCODE(const DnsMessage& m);
-  static bool hasTC(const DnsMessage& m);
-
-  static bool hasAnswerTypeForName(const DnsMessage& m, const string& qname, uint16_t qtype);
-  static vector<DnsRR> collectAnswerTypeForName(const DnsMessage& m, const string& qname, uint16_t qtype);
-  static optional<string> findCNAMEtargetFor(const DnsMessage& m, const string& qname);
-  static vector<string> collectNSNames(const DnsMessage& m);
-  static vector<string> collectGlueIPsFor(const DnsMessage& m, const unordered_set<string>& ns_names);
-  static optional<uint32_t> negativeTTL_from_SOA(const DnsMessage& m);
-
-  // Resolve A/AAAA de um hostname (p/ NS sem glue)
-  vector<string> resolveHostIPs(const string& start_ns_ip,
-                                          const string& host,
-                                          bool use_edns,
-                                          int timeout_ms,
-                                          int depth_budget);
-
-  // Cache: grava positivo/negativo
-  void putPositiveCache(const string& qname_norm, uint16_t qtype, const vector<DnsRR>& rrset);
-  void putNegativeCache(const string& qname_norm, uint16_t qtype,
-                        bool is_nxdomain, optional<uint32_t> neg_ttl_opt);
-
-  // Conversões/TTL
-  static vector<RR> toRRsetForCache(const vector<DnsRR>& v);
-  static uint32_t minTTL(const vector<DnsRR>& v);
-
-  // ------------ Decisão centralizada sobre uma resposta ------------
-  struct Decision {
-    enum class Kind { FINAL_OK, FINAL_NXDOMAIN, FINAL_NODATA, CNAME, REFERRAL, RETRY } kind = Kind::RETRY;
-    uint16_t rcode = 0;
-
-    // FINAL_OK
-    vector<DnsRR> rrset;
-
-    // FINAL_NX/NODATA
-    optional<uint32_t> negative_ttl;
-
-    // CNAME
-    string cname_target; // normalizado
-
-    // REFERRAL
-    vector<string> next_ns_ips;   // IPs de glue (se houver)
-    vector<string> next_ns_names; // nomes de NS (para resolver IP se não houver glue)
-  };
-
-  Decision analyzeResponse(const DnsMessage& m,
-                           const string& qname_norm,
-                           uint16_t qtype,
-                           const string& start_ns_ip,
-                           bool use_edns,
-                           int timeout_ms);
-
-  // helper de trace
-  void TRACE(const char* fmt, ...) const;
-};
+#pragma once
+#include <string>
+#include <optional>
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+#include <cstdarg>
+#include <string_view>
+#include "arena.h"
+#include "cache.h"
+#include "delegation_cache.h"
+#include "dns_wire.h"
+#include "cache_client.h"
+#include "transport_tls.h"
+
+// Resultado final "alto nível" para o modo iterativo + cache
+struct ResolveResult
+{
+  enum class Kind { OK, NXDOMAIN, NODATA, ERROR } kind = Kind::ERROR;
+  uint32_t ttl = 0;            // TTL efetivo (segundos)
+  vector<RR> rrset;            // RRset final quando OK
+  uint16_t rcode = 0;          // RCODE da última resposta analisada
+};
+
+// Resultado da consulta “1 salto” (direto ao NS), útil para debug
+struct SingleQueryResult
+{
+  bool ok = false;
+  bool via_tcp = false;     // true quando usou TCP (ou TLS/DoT)
+  uint16_t rcode = 0;
+  DnsMessage message;       // já parseada
+};
+
+class Resolver
+{
+public:
+  Resolver() = default;
+
+  // ---- DoT/DNS mode ----
+  enum class Mode { DNS, DOT };
+  void setMode(Mode m) { mode_ = m; }
+  void setSNI(const string& s) { sni_ = s; }
+  void setDotInsecure(bool b) { dot_insecure_ = b; }
+
+  // Ativa/desativa trace no console (stderr)
+  void setTrace(bool on) { trace_ = on; }
+
+  // Consulta direta (1 salto): 
+  // - DNS: UDP e fallback TCP se TC=1
+  // - DoT: TLS/853 com SNI e validação de certificado
+  optional<SingleQueryResult> singleQueryTo(const string& ns_ip,
+                                            const string& qname,
+                                            const string& qtype,
+                                            bool use_edns = true,
+                                            int timeout_ms = 3000);
+
+  // Resolução iterativa + cache (começa do NS informado; idealmente um root)
+  optional<ResolveResult> resolveRecursive(const string& start_ns_ip,
+                                            const string& qname_in,
+                                            const string& qtype_in,
+                                            bool use_edns = true,
+                                            int timeout_ms = 3000);
+
+private:
+  DnsCache cache_{50, 50};
+  DelegationCache delegations_;   // cortes de zona vistos em REFERRALs
+  bool trace_ = false;
+
+  // modo de transporte
+  Mode mode_ = Mode::DNS;
+  string sni_;
+  bool dot_insecure_ = false;
+
+  // cache daemon (opcional): se disponível, preferimos ele
+  CacheDaemonClient daemon_;
+  bool tried_daemon_ = false;
+
+  // Estado temporário da resolução em curso (zerado ao fim de cada uma)
+  ResolveArena arena_;
+
+  // ------------ Helpers básicos ------------
+  uint16_t parseType(const string& qtype);
+  uint64_t nowMs() const;
+
+  vector<uint8_t> buildQueryBytes(const string& qname, uint16_t qtype, bool use_edns) const;
+
+  // resp guarda os bytes recebidos; out é uma view sobre resp (sem cópia)
+  bool sendOnce(const pmr::string& ns_ip,
+                const pmr::vector<uint8_t>& q,
+                int timeout_ms,
+                pmr::vector<uint8_t>& resp,
+                DnsMessageView& out,
+                bool& via_tcp);
+
+  static uint16_t getRCODE(const DnsHeader& h);
+  static bool hasTC(const DnsHeader& h);
+
+  // Helpers sobre a view: qname já normalizado (comparação sem alocar).
+  // O que precisa ser copiado sai do alocador a (em geral, a arena).
+  using StrVec = pmr::vector<pmr::string>;
+
+  static bool hasAnswerTypeForName(const DnsMessageView& m, string_view qname_norm, uint16_t qtype);
+  static pmr::vector<DnsRR> collectAnswerTypeForName(const DnsMessageView& m, string_view qname_norm,
+                                                     uint16_t qtype, const dns_allocator& a);
+  static optional<pmr::string> findCNAMEtargetFor(const DnsMessageView& m, string_view qname_norm,
+                                                  const dns_allocator& a);
+  static StrVec collectNSNames(const DnsMessageView& m, const dns_allocator& a);
+  static StrVec collectGlueIPsFor(const DnsMessageView& m, const StrVec& ns_names,
+                                  const dns_allocator& a);
+  static optional<uint32_t> negativeTTL_from_SOA(const DnsMessageView& m);
+  // Dono dos NS da Authority (o corte de zona) e o menor TTL entre eles
+  static pair<pmr::string, uint32_t> referralCut(const DnsMessageView& m, const dns_allocator& a);
+
+  // Resolve A/AAAA de um hostname (p/ NS sem glue)
+  StrVec resolveHostIPs(const string& start_ns_ip,
+                        const pmr::string& host,
+                        bool use_edns,
+                        int timeout_ms,
+                        int depth_budget);
+
+  // Cache: grava positivo/negativo
+  void putPositiveCache(string_view qname_norm, uint16_t qtype, const pmr::vector<DnsRR>& rrset);
+  void putNegativeCache(string_view qname_norm, uint16_t qtype,
+                        bool is_nxdomain, optional<uint32_t> neg_ttl_opt);
+
+  // Conversões/TTL (o RRset convertido é o que fica na cache: heap global)
+  static vector<RR> toRRsetForCache(const pmr::vector<DnsRR>& v);
+  static uint32_t minTTL(const pmr::vector<DnsRR>& v);
+
+  // ------------ Decisão centralizada sobre uma resposta ------------
+  struct Decision {
+    using allocator_type = dns_allocator;
+
+    explicit Decision(const allocator_type& a = {})
+      : rrset(a), cname_target(a), next_ns_ips(a), next_ns_names(a), referral_zone(a) {}
+
+    enum class Kind { FINAL_OK, FINAL_NXDOMAIN, FINAL_NODATA, CNAME, REFERRAL, RETRY } kind = Kind::RETRY;
+    uint16_t rcode = 0;
+
+    // FINAL_OK
+    pmr::vector<DnsRR> rrset;
+
+    // FINAL_NX/NODATA
+    optional<uint32_t> negative_ttl;
+
+    // CNAME
+    pmr::string cname_target; // normalizado
+
+    // REFERRAL
+    StrVec next_ns_ips;   // IPs de glue (se houver)
+    StrVec next_ns_names; // nomes de NS (para resolver IP se não houver glue)
+    pmr::string referral_zone; // corte de zona (dono dos NS)
+    uint32_t referral_ttl = 0;
+  };
+
+  // Delegações: grava um REFERRAL e escolhe onde começar a iteração
+  void putDelegation(const Decision& d, const StrVec& ns_ips);
+  void startFromClosestCut(string_view qname_norm, const string& start_ns_ip,
+                           StrVec& ns_queue, pmr::string& zone);
+
+  // Decision e seus vetores saem da arena da resolução
+  Decision analyzeResponse(const DnsMessageView& m,
+                           string_view qname_norm,
+                           uint16_t qtype,
+                           const string& start_ns_ip,
+                           bool use_edns,
+                           int timeout_ms);
+
+  // helper de trace
+  void TRACE(const char* fmt, ...) const;
+};
@@ -1,17 +1,23 @@
-#pragma once
-#include <string>
-#include <vector>
-#include <cstdint>
-
-using namespace std;
-
-// Envia DNS/UDP (porta 53)
-// timeout_ms aplica em send e recv.
-vector<uint8_t> sendUDP(const string& server_ip, uint16_t port,
-                        const vector<uint8_t>& payload, int timeout_ms);
-
-// Envia DNS/TCP (porta 53) com prefixo de 2 bytes (tamanho)
-// timeout_ms aplica em connect, send e recv.
-// Retorna APENAS o payload DNS (sem os 2 bytes do tamanho).
-vector<uint8_t> sendTCP(const string& server_ip, uint16_t port,
-                        const vector<uint8_t>& payload, int timeout_ms);
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Envia DNS/UDP (porta 53)
+// timeout_ms aplica em send e recv.
+vector<uint8_t> sendUDP(const string& server_ip, uint16_t port,
+                        const vector<uint8_t>& payload, int timeout_ms);
+
+// Mesma coisa sem alocar buffers: a resposta é escrita em out (até out_cap bytes).
+// Retorna o tamanho recebido (0 indica falha/timeout).
+size_t sendUDP(const char* server_ip, uint16_t port,
+               const uint8_t* payload, size_t len,
+               uint8_t* out, size_t out_cap, int timeout_ms);
+
+// Envia DNS/TCP (porta 53) com prefixo de 2 bytes (tamanho)
+// timeout_ms aplica em connect, send e recv.
+// Retorna APENAS o payload DNS (sem os 2 bytes do tamanho).
+vector<uint8_t> sendTCP(const string& server_ip, uint16_t port,
+                        const vector<uint8_t>& payload, int timeout_ms);